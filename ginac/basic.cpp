@@ -434,6 +434,7 @@ struct evalf_map_function : public map_function {
 	PyObject* parent;
 	evalf_map_function(int l, PyObject* p) : level(l), parent(p) {}
 	ex operator()(const ex & e) override { return evalf(e, level, parent); }
+	bool is_pure() const override { return true; }
 };
 
 /** Evaluate object numerically. */
@@ -456,6 +457,7 @@ ex basic::evalf(int level, PyObject* parent) const
 /** Function object to be applied by basic::evalm(). */
 struct evalm_map_function : public map_function {
 	ex operator()(const ex & e) override { return evalm(e); }
+	bool is_pure() const override { return true; }
 } map_evalm;
 
 /** Evaluate sums, products and integer powers of matrices. */
@@ -470,6 +472,7 @@ ex basic::evalm() const
 /** Function object to be applied by basic::eval_integ(). */
 struct eval_integ_map_function : public map_function {
 	ex operator()(const ex & e) override { return eval_integ(e); }
+	bool is_pure() const override { return true; }
 } map_eval_integ;
 
 /** Evaluate integrals, if result is known. */
@@ -707,6 +710,7 @@ struct derivative_map_function : public map_function {
 	const symbol &s;
 	derivative_map_function(const symbol &sym) : s(sym) {}
 	ex operator()(const ex & e) override { return diff(e, s); }
+	bool is_pure() const override { return true; }
 };
 
 /** Default implementation of ex::diff(). It maps the operation on the
@@ -798,6 +802,7 @@ struct expand_map_function : public map_function {
 	unsigned options;
 	expand_map_function(unsigned o) : options(o) {}
 	ex operator()(const ex & e) override { return e.expand(options); }
+	bool is_pure() const override { return true; }
 };
 
 /** Expand expression, i.e. multiply it out and return the result as a new
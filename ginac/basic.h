@@ -89,6 +89,12 @@ struct map_function {
 	typedef const ex & argument_type;
 	typedef ex result_type;
 	virtual ex operator()(const ex & e) = 0;
+
+	/** True if operator() depends on its argument only and has no side
+	 *  effects.  When a large expression is traversed by applying such a
+	 *  map_function recursively, ex::map() remembers its results for
+	 *  shared nodes.  @see dag_call */
+	virtual bool is_pure() const { return false; }
 };
 
 
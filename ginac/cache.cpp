@@ -0,0 +1,137 @@
+/** @file cache.cpp
+ *
+ *  Implementation of the manager of GiNaC's internal caches. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "cache.h"
+
+#include <algorithm>
+#include <ostream>
+
+namespace GiNaC {
+
+//////////
+// class managed_cache
+//////////
+
+managed_cache::managed_cache(const std::string & n)
+  : cache_name(n), bytes(0)
+{
+	cache_manager::instance().add(this);
+}
+
+managed_cache::~managed_cache()
+{
+	cache_manager::instance().remove(this);
+}
+
+/** Report a change of the memory used by this cache.  Growth may make the
+ *  manager evict entries from this or other caches. */
+void managed_cache::account(std::ptrdiff_t delta)
+{
+	bytes += delta;
+	cache_manager::instance().changed(delta);
+}
+
+void managed_cache::show_statistics(std::ostream & os, unsigned level) const
+{
+	os << std::string(level, ' ') << cache_name << ": "
+	   << bytes << " bytes" << std::endl;
+}
+
+//////////
+// class cache_manager
+//////////
+
+cache_manager & cache_manager::instance()
+{
+	// never destroyed, caches may unregister during static destruction
+	static auto cm = new cache_manager;
+	return *cm;
+}
+
+/** Set the global budget in bytes, 0 meaning unlimited, and shrink the
+ *  caches if they use more than that already. */
+void cache_manager::set_budget(size_t b)
+{
+	max_bytes = b;
+	if (max_bytes != 0 && total_bytes > max_bytes)
+		shrink(max_bytes - max_bytes/10);
+}
+
+/** Evict entries, from the largest caches first, until all caches together
+ *  use at most 'target' bytes. */
+void cache_manager::shrink(size_t target)
+{
+	if (evicting)
+		return;
+	evicting = true;
+	while (total_bytes > target) {
+		auto largest = std::max_element(caches.begin(), caches.end(),
+			[](const managed_cache * a, const managed_cache * b)
+			{ return a->memory_size() < b->memory_size(); });
+		if (largest == caches.end() || (*largest)->memory_size() == 0)
+			break;
+		// a cache smaller than the excess is emptied and the loop goes on
+		// with the next one
+		const size_t before = (*largest)->memory_size();
+		(*largest)->evict(std::min(before, total_bytes - target));
+		if ((*largest)->memory_size() >= before)
+			break;  // nothing could be evicted
+	}
+	evicting = false;
+}
+
+/** Remove all entries from all caches. */
+void cache_manager::flush()
+{
+	evicting = true;
+	for (auto c : caches)
+		c->flush();
+	evicting = false;
+}
+
+void cache_manager::show_statistics(std::ostream & os) const
+{
+	os << "caches: " << total_bytes << " bytes";
+	if (max_bytes != 0)
+		os << " of " << max_bytes;
+	os << std::endl;
+	for (const auto c : caches)
+		c->show_statistics(os, 2);
+}
+
+void cache_manager::add(managed_cache * c)
+{
+	caches.push_back(c);
+}
+
+void cache_manager::remove(managed_cache * c)
+{
+	total_bytes -= c->memory_size();
+	caches.erase(std::remove(caches.begin(), caches.end(), c), caches.end());
+}
+
+void cache_manager::changed(std::ptrdiff_t delta)
+{
+	total_bytes += delta;
+	if (delta > 0 && max_bytes != 0 && total_bytes > max_bytes)
+		shrink(max_bytes - max_bytes/10);
+}
+
+} // namespace GiNaC
@@ -0,0 +1,94 @@
+/** @file cache.h
+ *
+ *  Interface to the manager of GiNaC's internal caches. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_CACHE_H__
+#define __GINAC_CACHE_H__
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace GiNaC {
+
+/** Base class of all caches taking part in the global memory budget.
+ *  A cache registers itself on construction and reports every change of
+ *  its (estimated) memory use through account(). */
+class managed_cache {
+public:
+	explicit managed_cache(const std::string & n);
+	virtual ~managed_cache();
+
+	const std::string & name() const { return cache_name; }
+	size_t memory_size() const { return bytes; }
+
+	/** Remove entries, least valuable first, until at least 'amount'
+	 *  bytes have been freed or the cache is empty. */
+	virtual void evict(size_t amount) = 0;
+
+	/** Remove all entries. */
+	virtual void flush() = 0;
+
+	virtual void show_statistics(std::ostream & os, unsigned level) const;
+
+protected:
+	void account(std::ptrdiff_t delta);
+
+private:
+	std::string cache_name;
+	size_t bytes;
+};
+
+/** The cache manager knows all internal caches (function remember
+ *  tables, the numerical integration cache, ...) and keeps their total
+ *  memory use below a global budget.  When the budget is exceeded, entries
+ *  are evicted from the largest caches first until 90% of the budget is
+ *  reached.  A budget of 0, the default, means no limit.
+ *
+ *  Long running programs can also shrink or flush all caches explicitly,
+ *  e.g. between independent jobs. */
+class cache_manager {
+	friend class managed_cache;
+public:
+	static cache_manager & instance();
+
+	void set_budget(size_t b);
+	size_t budget() const { return max_bytes; }
+	size_t memory_size() const { return total_bytes; }
+
+	void shrink(size_t target);
+	void flush();
+	void show_statistics(std::ostream & os) const;
+
+protected:
+	cache_manager() : max_bytes(0), total_bytes(0), evicting(false) {}
+	void add(managed_cache * c);
+	void remove(managed_cache * c);
+	void changed(std::ptrdiff_t delta);
+
+	std::vector<managed_cache *> caches;
+	size_t max_bytes;
+	size_t total_bytes;
+	bool evicting;
+};
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_CACHE_H__
@@ -0,0 +1,392 @@
+/** @file codegen.cpp
+ *
+ *  Generation of C code for expressions. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "codegen.h"
+#include "add.h"
+#include "cse.h"
+#include "ex.h"
+#include "flags.h"
+#include "mul.h"
+#include "numeric.h"
+#include "operators.h"
+#include "power.h"
+#include "relational.h"
+#include "symbol.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace GiNaC {
+
+namespace {
+
+/** Degree of the term t as a monomial in x, with the cofactor returned in
+ *  coeff, or -1 if x occurs in t in some other way. */
+long monomial_degree(const ex & t, const ex & x, ex & coeff)
+{
+	if (!t.has(x)) {
+		coeff = t;
+		return 0;
+	}
+	if (t.is_equal(x)) {
+		coeff = _ex1;
+		return 1;
+	}
+	if (is_exactly_a<power>(t)) {
+		if (t.op(0).is_equal(x) && t.op(1).info(info_flags::posint)) {
+			coeff = _ex1;
+			return ex_to<numeric>(t.op(1)).to_long();
+		}
+		return -1;
+	}
+	if (is_exactly_a<mul>(t)) {
+		long deg = -1;
+		for (size_t i=0; i<t.nops(); ++i) {
+			const ex & f = t.op(i);
+			if (!f.has(x))
+				continue;
+			ex c;
+			deg = monomial_degree(f, x, c);
+			if (deg < 0 || !c.is_equal(_ex1))
+				return -1;
+		}
+		coeff = t * power(x, -deg);
+		return deg;
+	}
+	return -1;
+}
+
+class horner_map : public map_function {
+public:
+	horner_map(const lst & v) : vars(v) { }
+
+	ex operator()(const ex & e) override
+	{
+		if (!is_exactly_a<add>(e))
+			return e.map(*this);
+
+		// the variable occurring as a power in most terms goes outside
+		ex x;
+		size_t best = 1;
+		for (const auto & v : vars) {
+			size_t count = 0;
+			for (size_t i=0; i<e.nops(); ++i) {
+				ex c;
+				if (monomial_degree(e.op(i), v, c) > 0)
+					++count;
+			}
+			if (count > best) {
+				best = count;
+				x = v;
+			}
+		}
+		if (best < 2)
+			return e.map(*this);
+
+		// e = sum of c_k x^k + rest, where x does not occur in the c_k
+		// as a power
+		std::map<long, exvector> coeffs;
+		exvector rest;
+		for (size_t i=0; i<e.nops(); ++i) {
+			ex c;
+			long k = monomial_degree(e.op(i), x, c);
+			if (k < 0)
+				rest.push_back(e.op(i));
+			else
+				coeffs[k].push_back(c);
+		}
+
+		// (... (c_n x^(n-m) + c_m) x^(m-l) + ...) x^l
+		auto it = coeffs.rbegin();
+		ex r = (*this)((new add(it->second))->setflag(status_flags::dynallocated));
+		long deg = it->first;
+		for (++it; it!=coeffs.rend(); ++it) {
+			r = r * power(x, deg - it->first)
+			  + (*this)((new add(it->second))->setflag(status_flags::dynallocated));
+			deg = it->first;
+		}
+		if (deg > 0)
+			r = r * power(x, deg);
+		if (!rest.empty())
+			r += (*this)((new add(rest))->setflag(status_flags::dynallocated));
+		return r;
+	}
+
+	bool is_pure() const override { return true; }
+
+private:
+	const lst & vars;
+};
+
+/** Collect the names of the symbols in e, visiting shared nodes once. */
+void collect_symbol_names(const ex & e, std::set<std::string> & names,
+                          std::unordered_set<const basic *> & seen)
+{
+	if (is_exactly_a<symbol>(e)) {
+		names.insert(ex_to<symbol>(e).get_name());
+		return;
+	}
+	if (e.nops() == 0 || !seen.insert(&ex_to<basic>(e)).second)
+		return;
+	for (size_t i=0; i<e.nops(); ++i)
+		collect_symbol_names(e.op(i), names, seen);
+}
+
+/** A prefix for the names of the temporaries, which are the prefix
+ *  followed by digits or by '_', such that no symbol has one of them. */
+std::string temporary_prefix(const std::set<std::string> & names)
+{
+	std::string prefix = "t";
+	for (;;) {
+		bool collides = false;
+		for (const auto & n : names) {
+			if (n.size() <= prefix.size() || n.compare(0, prefix.size(), prefix) != 0)
+				continue;
+			const std::string rest = n.substr(prefix.size());
+			if (rest[0] == '_' || std::all_of(rest.begin(), rest.end(),
+			                                  [](char ch) { return std::isdigit((unsigned char)ch); })) {
+				collides = true;
+				break;
+			}
+		}
+		if (!collides)
+			return prefix;
+		prefix += "t";
+	}
+}
+
+const char * csrc_type(const print_csrc & c)
+{
+	if (is_a<print_csrc_float>(c))
+		return "float";
+	if (is_a<print_csrc_cl_N>(c))
+		return "cl_N";
+	return "double";
+}
+
+/** Replaces integer powers by variables holding them.  The definitions
+ *  are printed when a power is first needed, each power being the product
+ *  of two lower ones, so x^2, x^3, x^5 take one multiplication each. */
+class csrc_powers : public map_function {
+public:
+	csrc_powers(const print_csrc & c_, const std::string & prefix_, size_t first_temp)
+	  : c(c_), prefix(prefix_), next_temp(first_temp) { }
+
+	ex operator()(const ex & e) override
+	{
+		if (is_exactly_a<symbol>(e)) {
+			auto found = aliases.find(e);
+			return found != aliases.end() ? found->second : e;
+		}
+		if (!is_exactly_a<power>(e) || !e.op(1).info(info_flags::integer)
+		    || std::labs(ex_to<numeric>(e.op(1)).to_long()) < 2)
+			return e.map(*this);
+
+		ex base = e.op(0);
+		if (!is_exactly_a<symbol>(base)) {
+			auto found = bases.find(base);
+			if (found == bases.end()) {
+				const ex value = (*this)(base);
+				symbol t(prefix + std::to_string(next_temp++));
+				define(t, value);
+				found = bases.insert(std::make_pair(base, ex(t))).first;
+			}
+			base = found->second;
+		}
+
+		long n = ex_to<numeric>(e.op(1)).to_long();
+		if (n > 0)
+			return power_of(base, n);
+		return power(power_of(base, -n), _ex_1);
+	}
+
+	/** Print the definition of lhs, or if rhs is just a variable, use that
+	 *  in place of lhs. */
+	void define(const ex & lhs, const ex & rhs)
+	{
+		if (is_exactly_a<symbol>(rhs)) {
+			aliases[lhs] = rhs;
+			return;
+		}
+		c.s << "\tconst " << csrc_type(c) << " ";
+		lhs.print(c);
+		c.s << " = ";
+		rhs.print(c);
+		c.s << ";\n";
+	}
+
+private:
+	ex power_of(const ex & s, long n)
+	{
+		if (n == 1)
+			return s;
+		auto & known = powers[s];
+		auto found = known.find(n);
+		if (found != known.end())
+			return found->second;
+
+		// reuse two known powers adding up to n if there are some,
+		// otherwise square or multiply by s
+		ex a, b;
+		for (const auto & k : known) {
+			if (k.first >= n)
+				break;
+			if (k.first == n - 1) {
+				a = k.second;
+				b = s;
+				break;
+			}
+			auto other = known.find(n - k.first);
+			if (other != known.end()) {
+				a = k.second;
+				b = other->second;
+				break;
+			}
+		}
+		if (a.is_zero()) {
+			if (n % 2 == 0)
+				a = b = power_of(s, n/2);
+			else {
+				a = power_of(s, n - 1);
+				b = s;
+			}
+		}
+
+		symbol p(prefix + "_" + ex_to<symbol>(s).get_name() + "_pow" + std::to_string(n));
+		c.s << "\tconst " << csrc_type(c) << " ";
+		p.print(c);
+		c.s << " = ";
+		a.print(c);
+		c.s << "*";
+		b.print(c);
+		c.s << ";\n";
+		powers[s][n] = p;
+		return p;
+	}
+
+	const print_csrc & c;
+	const std::string prefix;
+	size_t next_temp;
+	exmap bases;
+	exmap aliases;
+	std::map<ex, std::map<long, ex>, ex_is_less> powers;
+};
+
+} // anonymous namespace
+
+/** Rewrite the polynomial parts of e in Horner form.  In each sum the
+ *  variable occurring as a power in most terms is factored out repeatedly,
+ *  which recursively applies to the coefficients and to the other terms.
+ *  For instance, a*x^3 + b*x + c*x*y + d becomes (a*x^2 + b + c*y)*x + d.
+ *
+ *  @param e  expression
+ *  @param vars  list of symbols which may be factored out
+ *  @return e with sums in Horner form */
+ex horner(const ex & e, const lst & vars)
+{
+	horner_map h(vars);
+	return h(e);
+}
+
+/** Print a complete C function computing e.  Polynomials are printed in
+ *  Horner form, common subexpressions are assigned to temporaries and
+ *  integer powers are computed from lower powers of the same base.  The
+ *  names of the temporaries differ from those of the symbols in e and args.
+ *
+ *  The function returns the value of e, or if e is a list, stores the
+ *  values of its elements in out[0], out[1], ..., passed as last argument.
+ *  The floating point type is that of the context.
+ *
+ *  @param c  C source print context, print_csrc_double or print_csrc_float
+ *  @param name  name of the function
+ *  @param e  expression or list of expressions
+ *  @param args  symbols which are the arguments of the function
+ *  @param options  codegen_options::array_arguments passes the arguments
+ *         in an array args[0], args[1], ...
+ *  @exception invalid_argument if an argument is not a symbol */
+void print_csrc_function(const print_csrc & c, const std::string & name,
+                         const ex & e, const lst & args, unsigned options)
+{
+	for (const auto & a : args)
+		if (!is_exactly_a<symbol>(a))
+			throw std::invalid_argument("print_csrc_function(): arguments must be symbols");
+
+	const std::string type = csrc_type(c);
+	const bool vector = is_exactly_a<lst>(e);
+	std::set<std::string> names;
+	std::unordered_set<const basic *> seen;
+	collect_symbol_names(e, names, seen);
+	for (const auto & a : args)
+		names.insert(ex_to<symbol>(a).get_name());
+	const std::string prefix = temporary_prefix(names);
+	lst temporaries;
+	const ex reduced = cse(horner(e, args), temporaries, prefix);
+
+	c.s << (vector ? "void" : type.c_str()) << " " << name << "(";
+	if (options & codegen_options::array_arguments)
+		c.s << "const " << type << " * args";
+	else {
+		size_t i = 0;
+		for (const auto & a : args) {
+			if (i++ != 0)
+				c.s << ", ";
+			c.s << "const " << type << " ";
+			a.print(c);
+		}
+	}
+	if (vector) {
+		if (args.nops() != 0)
+			c.s << ", ";
+		c.s << type << " * out";
+	}
+	c.s << ")\n{\n";
+
+	csrc_powers powers(c, prefix, temporaries.nops());
+	if (options & codegen_options::array_arguments) {
+		size_t i = 0;
+		for (const auto & a : args)
+			c.s << "\tconst " << type << " " << ex_to<symbol>(a).get_name()
+			    << " = args[" << i++ << "];\n";
+	}
+	for (const auto & t : temporaries)
+		powers.define(t.lhs(), powers(t.rhs()));
+	if (vector) {
+		for (size_t i=0; i<reduced.nops(); ++i) {
+			const ex value = powers(reduced.op(i));
+			c.s << "\tout[" << i << "] = ";
+			value.print(c);
+			c.s << ";\n";
+		}
+	} else {
+		const ex value = powers(reduced);
+		c.s << "\treturn ";
+		value.print(c);
+		c.s << ";\n";
+	}
+	c.s << "}\n";
+}
+
+} // namespace GiNaC
@@ -0,0 +1,42 @@
+/** @file codegen.h
+ *
+ *  Interface to the generation of C code for expressions. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_CODEGEN_H__
+#define __GINAC_CODEGEN_H__
+
+#include "lst.h"
+#include "print.h"
+
+#include <string>
+
+namespace GiNaC {
+
+class ex;
+
+// Horner form of the polynomial parts of e in the variables vars
+extern ex horner(const ex & e, const lst & vars);
+
+// Print a C function computing e, or each element of e if it is a list
+extern void print_csrc_function(const print_csrc & c, const std::string & name,
+                                const ex & e, const lst & args, unsigned options = 0);
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_CODEGEN_H__
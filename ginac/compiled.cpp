@@ -0,0 +1,511 @@
+/** @file compiled.cpp
+ *
+ *  Implementation of expressions compiled for fast numerical evaluation. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "compiled.h"
+#include "add.h"
+#include "compiler.h"
+#include "constant.h"
+#include "function.h"
+#include "inifcns.h"
+#include "mul.h"
+#include "numeric.h"
+#include "operators.h"
+#include "power.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace GiNaC {
+
+namespace {
+
+// opcodes, the operands are registers a and b, or the integer n
+enum compiled_opcode {
+	op_add,     // a + b
+	op_mul,     // a * b
+	op_powi,    // a ^ n
+	op_pow,     // a ^ b
+	op_sqrt,
+	op_exp,
+	op_log,
+	op_sin,
+	op_cos,
+	op_tan,
+	op_asin,
+	op_acos,
+	op_atan,
+	op_atan2,   // atan2(a, b)
+	op_sinh,
+	op_cosh,
+	op_tanh,
+	op_asinh,
+	op_acosh,
+	op_atanh,
+	op_abs
+};
+
+// opcode of the function with the given serial, or -1
+int function_opcode(unsigned serial, size_t nargs)
+{
+	if (nargs == 2)
+		return serial == atan2_SERIAL::serial ? op_atan2 : -1;
+	if (nargs != 1)
+		return -1;
+	static const std::map<unsigned, int> ops = {
+		{ exp_SERIAL::serial, op_exp },
+		{ log_SERIAL::serial, op_log },
+		{ sin_SERIAL::serial, op_sin },
+		{ cos_SERIAL::serial, op_cos },
+		{ tan_SERIAL::serial, op_tan },
+		{ asin_SERIAL::serial, op_asin },
+		{ acos_SERIAL::serial, op_acos },
+		{ atan_SERIAL::serial, op_atan },
+		{ sinh_SERIAL::serial, op_sinh },
+		{ cosh_SERIAL::serial, op_cosh },
+		{ tanh_SERIAL::serial, op_tanh },
+		{ asinh_SERIAL::serial, op_asinh },
+		{ acosh_SERIAL::serial, op_acosh },
+		{ atanh_SERIAL::serial, op_atanh },
+		{ abs_SERIAL::serial, op_abs }
+	};
+	auto it = ops.find(serial);
+	return it == ops.end() ? -1 : it->second;
+}
+
+template <typename T>
+inline T powi(T x, long n)
+{
+	unsigned long m = n < 0 ? -n : n;
+	T r = 1;
+	while (m != 0) {
+		if (m & 1)
+			r *= x;
+		x *= x;
+		m >>= 1;
+	}
+	return n < 0 ? T(1) / r : r;
+}
+
+inline double atan2_(double y, double x)
+{
+	return std::atan2(y, x);
+}
+
+// -I*log((x+I*y)/sqrt(x^2+y^2)), see GiNaC::atan(y, x)
+inline std::complex<double> atan2_(const std::complex<double> & y, const std::complex<double> & x)
+{
+	const std::complex<double> I(0, 1);
+	return -I * std::log((x + I*y) / std::sqrt(x*x + y*y));
+}
+
+inline void from_complex(const std::complex<double> & z, double & d)
+{
+	d = z.real();
+}
+
+inline void from_complex(const std::complex<double> & z, std::complex<double> & c)
+{
+	c = z;
+}
+
+// number of points a batch evaluation runs through the program together
+const size_t block_size = 64;
+
+} // anonymous namespace
+
+compiled_ex::compiled_ex(const ex & e, const std::vector<symbol> & vars)
+  : nvars(vars.size()), nregs(vars.size()), real(true), real_partials(true)
+{
+	std::map<ex, unsigned, ex_is_less> regs;
+	for (unsigned i=0; i<nvars; ++i)
+		regs.insert(std::make_pair(ex(vars[i]), i));
+	result = compile(e, regs);
+	compile_partials(regs);
+
+	dregs.resize(nregs);
+	cregs.resize(nregs);
+	dadjoints.resize(nregs);
+	cadjoints.resize(nregs);
+	for (const auto & c : constants) {
+		dregs[c.first] = c.second.real();
+		cregs[c.first] = c.second;
+	}
+}
+
+unsigned compiled_ex::emit(unsigned char op, unsigned a, unsigned b, long n)
+{
+	instruction i = { op, nregs, a, b, n };
+	code.push_back(i);
+	return nregs++;
+}
+
+/** Emit the code computing e, unless it has been computed before, and
+ *  return the register holding its value. */
+unsigned compiled_ex::compile(const ex & e, std::map<ex, unsigned, ex_is_less> & regs)
+{
+	auto it = regs.find(e);
+	if (it != regs.end())
+		return it->second;
+
+	unsigned r;
+	if (is_exactly_a<numeric>(e) || is_exactly_a<constant>(e)) {
+		const ex val = e.evalf();
+		if (!is_exactly_a<numeric>(val))
+			throw std::invalid_argument("compiled_ex::compiled_ex(): constant without numerical value");
+		const numeric & num = ex_to<numeric>(val);
+		std::complex<double> z;
+		if (num.is_real()) {
+			z = num.to_double();
+		} else {
+			z = std::complex<double>(num.real().to_double(), num.imag().to_double());
+			real = false;
+		}
+		r = nregs++;
+		constants.push_back(std::make_pair(r, z));
+	} else if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+		const unsigned char op = is_exactly_a<add>(e) ? op_add : op_mul;
+		r = compile(e.op(0), regs);
+		for (size_t i=1; i<e.nops(); ++i)
+			r = emit(op, r, compile(e.op(i), regs));
+	} else if (is_exactly_a<power>(e)) {
+		const ex & expo = e.op(1);
+		const unsigned base = compile(e.op(0), regs);
+		if (is_exactly_a<numeric>(expo) && expo.info(info_flags::integer)
+		    && abs(ex_to<numeric>(expo)) < 1L<<30) {
+			r = emit(op_powi, base, 0, ex_to<numeric>(expo).to_long());
+		} else if (expo.is_equal(_ex1_2)) {
+			r = emit(op_sqrt, base);
+		} else if (expo.is_equal(_ex_1_2)) {
+			r = emit(op_powi, emit(op_sqrt, base), 0, -1);
+		} else {
+			r = emit(op_pow, base, compile(expo, regs));
+		}
+	} else if (is_exactly_a<function>(e)) {
+		const int op = function_opcode(ex_to<function>(e).get_serial(), e.nops());
+		if (op < 0) {
+			std::ostringstream os;
+			os << "compiled_ex::compiled_ex(): function " << ex_to<function>(e).get_name() << " cannot be compiled";
+			throw std::invalid_argument(os.str());
+		}
+		const unsigned a = compile(e.op(0), regs);
+		const unsigned b = e.nops() > 1 ? compile(e.op(1), regs) : 0;
+		r = emit(op, a, b);
+	} else if (is_exactly_a<symbol>(e)) {
+		std::ostringstream os;
+		os << "compiled_ex::compiled_ex(): " << e << " is not among the variables";
+		throw std::invalid_argument(os.str());
+	} else {
+		std::ostringstream os;
+		os << "compiled_ex::compiled_ex(): " << e << " cannot be compiled";
+		throw std::invalid_argument(os.str());
+	}
+	regs.insert(std::make_pair(e, r));
+	return r;
+}
+
+/** Emit the code computing the partial derivatives of each instruction
+ *  with respect to its operands, to be run after the program itself.  The
+ *  derivatives of functions are those given by their derivative_func.  If
+ *  one cannot be compiled, gradients are not available. */
+void compiled_ex::compile_partials(std::map<ex, unsigned, ex_is_less> & regs)
+{
+	// the function calls, by the register holding their value
+	std::map<unsigned, ex> calls;
+	for (const auto & r : regs)
+		if (is_exactly_a<function>(r.first))
+			calls.insert(std::make_pair(r.second, r.first));
+
+	// emit() appends to code, the program is put aside meanwhile
+	std::vector<instruction> program;
+	program.swap(code);
+	const bool real_program = real;
+	try {
+		const unsigned one = compile(_ex1, regs);
+		for (const auto & i : program) {
+			unsigned da = one, db = one;
+			switch (i.op) {
+				case op_add:
+					break;
+				case op_mul:
+					da = i.b;
+					db = i.a;
+					break;
+				case op_powi:  // n*a^(n-1)
+					da = emit(op_mul, compile(numeric(i.n), regs),
+					          emit(op_powi, i.a, 0, i.n - 1));
+					break;
+				case op_sqrt:  // 1/(2*d)
+					da = emit(op_mul, compile(_ex1_2, regs),
+					          emit(op_powi, i.dst, 0, -1));
+					break;
+				case op_pow:   // b*d/a, d*log(a)
+					da = emit(op_mul, i.b, emit(op_mul, i.dst, emit(op_powi, i.a, 0, -1)));
+					db = emit(op_mul, i.dst, emit(op_log, i.a));
+					break;
+				default: {
+					const function & f = ex_to<function>(calls.at(i.dst));
+					da = compile(f.pderivative(0), regs);
+					if (f.nops() > 1)
+						db = compile(f.pderivative(1), regs);
+				}
+			}
+			partials.push_back(std::make_pair(da, db));
+		}
+	} catch (std::exception & err) {
+		no_gradient = err.what();
+		partials.clear();
+		code.clear();
+	}
+	dcode.swap(code);
+	code.swap(program);
+	real_partials = real;
+	real = real_program;
+}
+
+template <typename T>
+void compiled_ex::run(const std::vector<instruction> & program, T * regs) const
+{
+	for (const auto & i : program) {
+		const T & a = regs[i.a];
+		const T & b = regs[i.b];
+		T & d = regs[i.dst];
+		switch (i.op) {
+			case op_add:   d = a + b; break;
+			case op_mul:   d = a * b; break;
+			case op_powi:  d = powi(a, i.n); break;
+			case op_pow:   d = std::pow(a, b); break;
+			case op_sqrt:  d = std::sqrt(a); break;
+			case op_exp:   d = std::exp(a); break;
+			case op_log:   d = std::log(a); break;
+			case op_sin:   d = std::sin(a); break;
+			case op_cos:   d = std::cos(a); break;
+			case op_tan:   d = std::tan(a); break;
+			case op_asin:  d = std::asin(a); break;
+			case op_acos:  d = std::acos(a); break;
+			case op_atan:  d = std::atan(a); break;
+			case op_atan2: d = atan2_(a, b); break;
+			case op_sinh:  d = std::sinh(a); break;
+			case op_cosh:  d = std::cosh(a); break;
+			case op_tanh:  d = std::tanh(a); break;
+			case op_asinh: d = std::asinh(a); break;
+			case op_acosh: d = std::acosh(a); break;
+			case op_atanh: d = std::atanh(a); break;
+			case op_abs:   d = std::abs(a); break;
+		}
+	}
+}
+
+// The registers are rows of block_size points.  The loops have a fixed
+// trip count and do not alias, so the compiler vectorizes them.
+#define BLOCK(expr) \
+	for (size_t j=0; j<block_size; ++j) \
+		d[j] = (expr); \
+	break
+
+template <typename T>
+GINAC_SIMD_CLONES
+void compiled_ex::run_block(T * regs) const
+{
+	for (const auto & i : code) {
+		const T * GINAC_RESTRICT a = regs + i.a * block_size;
+		const T * GINAC_RESTRICT b = regs + i.b * block_size;
+		T * GINAC_RESTRICT d = regs + i.dst * block_size;
+		switch (i.op) {
+			case op_add:   BLOCK(a[j] + b[j]);
+			case op_mul:   BLOCK(a[j] * b[j]);
+			case op_powi:
+				if (i.n == 2) {
+					BLOCK(a[j] * a[j]);
+				} else if (i.n == -1) {
+					BLOCK(T(1) / a[j]);
+				} else {
+					BLOCK(powi(a[j], i.n));
+				}
+			case op_pow:   BLOCK(std::pow(a[j], b[j]));
+			case op_sqrt:  BLOCK(std::sqrt(a[j]));
+			case op_exp:   BLOCK(std::exp(a[j]));
+			case op_log:   BLOCK(std::log(a[j]));
+			case op_sin:   BLOCK(std::sin(a[j]));
+			case op_cos:   BLOCK(std::cos(a[j]));
+			case op_tan:   BLOCK(std::tan(a[j]));
+			case op_asin:  BLOCK(std::asin(a[j]));
+			case op_acos:  BLOCK(std::acos(a[j]));
+			case op_atan:  BLOCK(std::atan(a[j]));
+			case op_atan2: BLOCK(atan2_(a[j], b[j]));
+			case op_sinh:  BLOCK(std::sinh(a[j]));
+			case op_cosh:  BLOCK(std::cosh(a[j]));
+			case op_tanh:  BLOCK(std::tanh(a[j]));
+			case op_asinh: BLOCK(std::asinh(a[j]));
+			case op_acosh: BLOCK(std::acosh(a[j]));
+			case op_atanh: BLOCK(std::atanh(a[j]));
+			case op_abs:   BLOCK(std::abs(a[j]));
+		}
+	}
+}
+
+#undef BLOCK
+
+template <typename T>
+void compiled_ex::run_batch(size_t n, const T * const * args, T * out, unsigned threads) const
+{
+	const size_t blocks = (n + block_size - 1) / block_size;
+	if (threads > blocks)
+		threads = blocks;
+	if (threads < 1)
+		threads = 1;
+
+	// evaluate the points [first, last) with registers of its own; the
+	// unused lanes of a partial block are computed on zeros
+	auto work = [&](size_t first, size_t last) {
+		std::vector<T> regs(nregs * block_size);
+		for (const auto & c : constants) {
+			T val;
+			from_complex(c.second, val);
+			std::fill_n(regs.begin() + c.first * block_size, block_size, val);
+		}
+		for (size_t p=first; p<last; p+=block_size) {
+			const size_t w = std::min(block_size, last - p);
+			for (unsigned v=0; v<nvars; ++v) {
+				auto row = regs.begin() + v * block_size;
+				std::copy(args[v] + p, args[v] + p + w, row);
+				std::fill(row + w, row + block_size, T(0));
+			}
+			run_block(regs.data());
+			std::copy(regs.begin() + result * block_size,
+			          regs.begin() + result * block_size + w, out + p);
+		}
+	};
+
+	// whole blocks per thread, so the split does not change any result
+	const size_t per_thread = (blocks + threads - 1) / threads * block_size;
+	std::vector<std::thread> pool;
+	for (unsigned t=1; t<threads; ++t) {
+		const size_t first = t * per_thread;
+		if (first < n)
+			pool.push_back(std::thread(work, first, std::min(n, first + per_thread)));
+	}
+	work(0, std::min(n, per_thread));
+	for (auto & th : pool)
+		th.join();
+}
+
+void compiled_ex::evaluate(size_t n, const double * const * args, double * out, unsigned threads) const
+{
+	if (!real)
+		throw std::domain_error("compiled_ex::evaluate(): expression has complex constants");
+	run_batch(n, args, out, threads);
+}
+
+void compiled_ex::evaluate(size_t n, const std::complex<double> * const * args, std::complex<double> * out, unsigned threads) const
+{
+	run_batch(n, args, out, threads);
+}
+
+/** Evaluate at the real point args[0], ..., args[nargs()-1].  Where the
+ *  result would not be real, e.g. the logarithm of a negative number, NaN
+ *  is returned.
+ *  @exception domain_error if the expression has complex constants */
+double compiled_ex::evaluate(const double * args) const
+{
+	if (!real)
+		throw std::domain_error("compiled_ex::evaluate(): expression has complex constants");
+	std::copy(args, args + nvars, dregs.begin());
+	run(code, dregs.data());
+	return dregs[result];
+}
+
+/** Evaluate at the complex point args[0], ..., args[nargs()-1]. */
+std::complex<double> compiled_ex::evaluate(const std::complex<double> * args) const
+{
+	std::copy(args, args + nvars, cregs.begin());
+	run(code, cregs.data());
+	return cregs[result];
+}
+
+/** Run the program and its partial derivatives, then propagate the
+ *  derivative of the result back through the instructions in reverse
+ *  order. */
+template <typename T>
+T compiled_ex::run_gradient(const T * args, T * grad, T * regs, T * adjoints) const
+{
+	if (!no_gradient.empty())
+		throw std::domain_error("compiled_ex::gradient(): " + no_gradient);
+	std::copy(args, args + nvars, regs);
+	run(code, regs);
+	run(dcode, regs);
+
+	std::fill(adjoints, adjoints + nregs, T(0));
+	adjoints[result] = T(1);
+	for (size_t k=code.size(); k-->0; ) {
+		const instruction & i = code[k];
+		const T w = adjoints[i.dst];
+		if (w == T(0))
+			continue;
+		adjoints[i.a] += w * regs[partials[k].first];
+		if (i.op == op_add || i.op == op_mul || i.op == op_pow || i.op == op_atan2)
+			adjoints[i.b] += w * regs[partials[k].second];
+	}
+	std::copy(adjoints, adjoints + nvars, grad);
+	return regs[result];
+}
+
+/** Evaluate at the real point args[0], ..., args[nargs()-1] and store the
+ *  partial derivatives with respect to the arguments in grad[0], ...,
+ *  grad[nargs()-1].
+ *  @return the value at args
+ *  @exception domain_error if the derivatives have complex constants or
+ *  a function has no derivative that can be compiled */
+double compiled_ex::gradient(const double * args, double * grad) const
+{
+	if (!real_partials)
+		throw std::domain_error("compiled_ex::gradient(): derivatives have complex constants");
+	return run_gradient(args, grad, dregs.data(), dadjoints.data());
+}
+
+/** Evaluate at the complex point args[0], ..., args[nargs()-1] and store
+ *  the partial derivatives with respect to the arguments in grad[0], ...,
+ *  grad[nargs()-1].
+ *  @return the value at args
+ *  @exception domain_error if a function has no derivative that can be
+ *  compiled */
+std::complex<double> compiled_ex::gradient(const std::complex<double> * args, std::complex<double> * grad) const
+{
+	return run_gradient(args, grad, cregs.data(), cadjoints.data());
+}
+
+double compiled_ex::operator()(const std::vector<double> & args) const
+{
+	if (args.size() != nvars)
+		throw std::invalid_argument("compiled_ex::operator(): wrong number of arguments");
+	return evaluate(args.data());
+}
+
+std::complex<double> compiled_ex::operator()(const std::vector<std::complex<double>> & args) const
+{
+	if (args.size() != nvars)
+		throw std::invalid_argument("compiled_ex::operator(): wrong number of arguments");
+	return evaluate(args.data());
+}
+
+} // namespace GiNaC
@@ -0,0 +1,114 @@
+/** @file compiled.h
+ *
+ *  Interface to expressions compiled for fast numerical evaluation. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_COMPILED_H__
+#define __GINAC_COMPILED_H__
+
+#include "ex.h"
+#include "symbol.h"
+
+#include <complex>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GiNaC {
+
+/** An expression translated into a program for a register machine that
+ *  works on doubles or complex doubles.  Sums, products, powers, numbers,
+ *  constants and the elementary functions are compiled; every distinct
+ *  subexpression is computed only once.  Evaluating the program does not
+ *  allocate memory and does not call into Python, which makes it suitable
+ *  for evaluating the same expression at very many points.
+ *
+ *  The registers are kept in the object, so one compiled_ex must not be
+ *  evaluated by several threads at the same time; copy it instead. */
+class compiled_ex {
+public:
+	/** Compile e as a function of vars, in this order.
+	 *  @exception invalid_argument if e contains other symbols or objects
+	 *  which cannot be evaluated numerically */
+	compiled_ex(const ex & e, const std::vector<symbol> & vars);
+
+	double operator()(const std::vector<double> & args) const;
+	std::complex<double> operator()(const std::vector<std::complex<double>> & args) const;
+	double evaluate(const double * args) const;
+	std::complex<double> evaluate(const std::complex<double> * args) const;
+
+	/** Evaluate at n points at once.  args[i] points to the n values of
+	 *  the i-th variable, the values of the expression are stored in
+	 *  out[0], ..., out[n-1].  Blocks of points run through the
+	 *  program together, each instruction acting on a whole block, so
+	 *  that the vector units are used.  With threads > 1 the points are
+	 *  split among that many threads. */
+	void evaluate(size_t n, const double * const * args, double * out, unsigned threads = 1) const;
+	void evaluate(size_t n, const std::complex<double> * const * args, std::complex<double> * out, unsigned threads = 1) const;
+
+	/** Evaluate and compute the gradient in reverse mode, i.e. with one
+	 *  run of the program followed by one sweep back over it.  The cost
+	 *  is a small multiple of that of evaluate(), independently of the
+	 *  number of arguments. */
+	double gradient(const double * args, double * grad) const;
+	std::complex<double> gradient(const std::complex<double> * args, std::complex<double> * grad) const;
+
+	/** Number of arguments. */
+	size_t nargs() const { return nvars; }
+
+	/** Number of instructions of the program. */
+	size_t size() const { return code.size(); }
+
+	/** False if the expression has complex constants and can only be
+	 *  evaluated at complex arguments. */
+	bool is_real() const { return real; }
+
+protected:
+	struct instruction {
+		unsigned char op;
+		unsigned dst, a, b;
+		long n;
+	};
+
+	unsigned compile(const ex & e, std::map<ex, unsigned, ex_is_less> & regs);
+	unsigned emit(unsigned char op, unsigned a, unsigned b = 0, long n = 0);
+	void compile_partials(std::map<ex, unsigned, ex_is_less> & regs);
+	template <typename T> void run(const std::vector<instruction> & program, T * regs) const;
+	template <typename T> T run_gradient(const T * args, T * grad, T * regs, T * adjoints) const;
+	template <typename T> void run_block(T * regs) const;
+	template <typename T> void run_batch(size_t n, const T * const * args, T * out, unsigned threads) const;
+
+protected:
+	std::vector<instruction> code;                ///< the program
+	std::vector<std::pair<unsigned, std::complex<double>>> constants;  ///< registers holding numbers
+	unsigned nvars;    ///< the arguments are held in registers 0, ..., nvars-1
+	unsigned nregs;    ///< number of registers
+	unsigned result;   ///< register holding the value after a run
+	bool real;         ///< all constants are real
+	std::vector<instruction> dcode;               ///< computes the partial derivatives
+	std::vector<std::pair<unsigned, unsigned>> partials;  ///< registers holding d/da and d/db of each instruction
+	bool real_partials;       ///< all constants of dcode are real
+	std::string no_gradient;  ///< why gradients cannot be computed, empty if they can
+	mutable std::vector<double> dregs, dadjoints;
+	mutable std::vector<std::complex<double>> cregs, cadjoints;
+};
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_COMPILED_H__
@@ -9,4 +9,18 @@
 #define likely(cond) (cond)
 #endif
 
+#ifdef __GNUC__
+#define GINAC_RESTRICT __restrict__
+#else
+#define GINAC_RESTRICT
+#endif
+
+// Compile a function for several x86 vector extensions, the best one the
+// processor supports is picked when the library is loaded.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define GINAC_SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define GINAC_SIMD_CLONES
+#endif
+
 #endif /* GINAC_COMPILER_DEP_HH */
@@ -0,0 +1,114 @@
+/** @file cse.cpp
+ *
+ *  Elimination of common subexpressions. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "cse.h"
+#include "ex.h"
+#include "expairseq.h"
+#include "function.h"
+#include "operators.h"
+#include "power.h"
+#include "relational.h"
+#include "symbol.h"
+
+#include <map>
+
+namespace GiNaC {
+
+namespace {
+
+/** Whether a temporary may stand for e.  Symbols, numbers and constants
+ *  are cheaper than a temporary and containers like lists and relations
+ *  are not values. */
+bool is_cse_candidate(const ex & e)
+{
+	return is_a<expairseq>(e) || is_a<power>(e) || is_a<function>(e);
+}
+
+class cse_replacer : public map_function {
+public:
+	cse_replacer(lst & t, const std::string & p)
+	  : temporaries(t), prefix(p), next(t.nops()) { }
+
+	/** Count how often every node is used.  The nodes below a node are
+	 *  visited only the first time it is seen, because all of its
+	 *  occurrences will be replaced by the same temporary. */
+	void count(const ex & e)
+	{
+		if (e.nops() == 0)
+			return;
+		if (++uses[e] > 1)
+			return;
+		for (size_t i=0; i<e.nops(); ++i)
+			count(e.op(i));
+	}
+
+	/** Rebuild e bottom-up, introducing a temporary for each node used
+	 *  more than once.  The definitions are appended to the list in the
+	 *  order of evaluation. */
+	ex operator()(const ex & e) override
+	{
+		if (e.nops() == 0)
+			return e;
+		auto found = done.find(e);
+		if (found != done.end())
+			return found->second;
+
+		ex r = e.map(*this);
+		if (uses[e] > 1 && is_cse_candidate(e)) {
+			symbol t(prefix + std::to_string(next++));
+			temporaries.append(t == r);
+			r = t;
+		}
+		done.insert(std::make_pair(e, r));
+		return r;
+	}
+
+private:
+	lst & temporaries;
+	const std::string & prefix;
+	size_t next;
+	std::map<ex, unsigned, ex_is_less> uses;
+	exmap done;
+};
+
+} // anonymous namespace
+
+/** Eliminate common subexpressions.  Every sum, product, power and function
+ *  call occurring more than once in e, equal subexpressions being found by
+ *  their hash values, is computed once and assigned to a new symbol.  This
+ *  includes shared bases of different powers and repeated function calls.
+ *
+ *  e may be a list, the subexpressions shared by its elements are then
+ *  eliminated as well.
+ *
+ *  @param e  expression or list of expressions
+ *  @param temporaries  relations t == value are appended to this list, in
+ *         an order such that each value only refers to earlier temporaries
+ *  @param prefix  the temporaries are named prefix0, prefix1, ..., counting
+ *         from the number of elements the list had already
+ *  @return e with the temporaries substituted */
+ex cse(const ex & e, lst & temporaries, const std::string & prefix)
+{
+	cse_replacer r(temporaries, prefix);
+	r.count(e);
+	return r(e);
+}
+
+} // namespace GiNaC
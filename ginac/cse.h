@@ -0,0 +1,37 @@
+/** @file cse.h
+ *
+ *  Interface to the elimination of common subexpressions. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_CSE_H__
+#define __GINAC_CSE_H__
+
+#include "lst.h"
+
+#include <string>
+
+namespace GiNaC {
+
+class ex;
+
+// Replace the subexpressions occurring more than once in e by temporaries
+extern ex cse(const ex & e, lst & temporaries, const std::string & prefix = "t");
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_CSE_H__
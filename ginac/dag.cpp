@@ -0,0 +1,108 @@
+/** @file dag.cpp
+ *
+ *  Traversals of expressions which visit shared nodes only once. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "dag.h"
+#include "add.h"
+#include "function.h"
+#include "inifcns.h"
+#include "mul.h"
+#include "operators.h"
+#include "power.h"
+#include "utils.h"
+
+namespace GiNaC {
+
+//////////
+// class dag_derivative
+//////////
+
+bool dag_derivative::depends(const ex & e)
+{
+	if (is_exactly_a<symbol>(e))
+		return e.is_equal(x);
+	if (e.nops() == 0)
+		return e.has(x);
+	auto found = dependence.find(e);
+	if (found != dependence.end())
+		return found->second;
+
+	bool d = false;
+	for (size_t i=0; i<e.nops() && !d; ++i)
+		d = depends(e.op(i));
+	dependence.insert(std::make_pair(e, d));
+	return d;
+}
+
+ex dag_derivative::operator()(const ex & e)
+{
+	if (!depends(e))
+		return _ex0;
+	if (e.nops() == 0)
+		return e.diff(x);
+	auto found = derivatives.find(e);
+	if (found != derivatives.end())
+		return found->second;
+
+	ex d;
+	if (is_exactly_a<add>(e)) {
+		exvector terms;
+		for (size_t i=0; i<e.nops(); ++i)
+			if (depends(e.op(i)))
+				terms.push_back((*this)(e.op(i)));
+		d = (new add(terms))->setflag(status_flags::dynallocated);
+	} else if (is_exactly_a<mul>(e)) {
+		// D(a*b*c) = D(a)*b*c + a*D(b)*c + a*b*D(c)
+		exvector factors(e.begin(), e.end()), terms;
+		for (size_t i=0; i<factors.size(); ++i) {
+			if (!depends(e.op(i)))
+				continue;
+			factors[i] = (*this)(e.op(i));
+			terms.push_back((new mul(factors))->setflag(status_flags::dynallocated));
+			factors[i] = e.op(i);
+		}
+		d = (new add(terms))->setflag(status_flags::dynallocated);
+	} else if (is_exactly_a<power>(e)) {
+		const ex & b = e.op(0);
+		const ex & n = e.op(1);
+		if (!depends(n)) {
+			// D(b^n) = n * b^(n-1) * D(b)
+			d = n * power(b, n - _ex1) * (*this)(b);
+		} else {
+			// D(b^n) = b^n * (D(n)*ln(b) + n*D(b)/b)
+			d = e * ((*this)(n) * log(b) + n * (*this)(b) * power(b, _ex_1));
+		}
+	} else if (is_exactly_a<function>(e)
+	           && function::registered_functions()[ex_to<function>(e).get_serial()].applies_chain_rule()) {
+		// chain rule with the partial derivatives given by derivative_func;
+		// other functions take the derivative themselves, see below
+		const function & f = ex_to<function>(e);
+		exvector terms;
+		for (size_t i=0; i<e.nops(); ++i)
+			if (depends(e.op(i)))
+				terms.push_back(f.pderivative(i) * (*this)(e.op(i)));
+		d = (new add(terms))->setflag(status_flags::dynallocated);
+	} else
+		d = e.diff(x);
+
+	derivatives.insert(std::make_pair(e, d));
+	return d;
+}
+
+} // namespace GiNaC
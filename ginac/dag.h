@@ -0,0 +1,129 @@
+/** @file dag.h
+ *
+ *  Interface to traversals of expressions which visit shared nodes only
+ *  once. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_DAG_H__
+#define __GINAC_DAG_H__
+
+#include "basic.h"
+#include "ex.h"
+#include "symbol.h"
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace GiNaC {
+
+/** Number of nested calls of subs(), has(), diff() or map() with a pure
+ *  map_function after which their results are remembered for the rest of
+ *  the traversal. */
+const unsigned dag_memo_threshold = 1000;
+
+/** Bookkeeping for one top-level call of a recursive operation such as
+ *  subs(), has(), diff() or map().  Expressions produced by repeated
+ *  substitution share their subexpressions, and treating them as trees
+ *  may take exponential time.  Therefore the nested calls for
+ *  subexpressions are counted, and when there have been more than
+ *  dag_memo_threshold of them, their results are remembered by the
+ *  address of the node.  The nodes are held, so that their addresses
+ *  cannot be reused during the call.
+ *
+ *  Only nested calls with the same argument (substitution map, pattern,
+ *  symbol or map_function, by address) and options as the top-level call
+ *  use the table, other ones are passed through.
+ *
+ *  @see dag_apply */
+template <typename T>
+class dag_call {
+public:
+	dag_call(const void * arg, unsigned opt)
+	  : argument(arg), options(opt), visits(0) { }
+
+	/** Whether a nested call with these arguments belongs to this call. */
+	bool applies(const void * arg, unsigned opt) const
+	{ return arg == argument && opt == options; }
+
+	/** Count a nested call, return true if results are remembered. */
+	bool count() { return ++visits > dag_memo_threshold; }
+
+	const T * find(const ex & e) const
+	{
+		auto it = results.find(&ex_to<basic>(e));
+		return it == results.end() ? nullptr : &it->second.second;
+	}
+
+	void insert(const ex & e, const T & r)
+	{ results.insert(std::make_pair(&ex_to<basic>(e), std::make_pair(e, r))); }
+
+private:
+	const void * argument;
+	unsigned options;
+	unsigned visits;
+	std::unordered_map<const basic *, std::pair<ex, T>> results;
+};
+
+/** Compute the result of an operation on e, which is compute(), using and
+ *  updating the table of the active top-level call.  If there is none,
+ *  this call becomes the active one until it returns. */
+template <typename T, typename F>
+T dag_apply(dag_call<T> * & active, const ex & e, const void * arg, unsigned options, F compute)
+{
+	if (active == nullptr) {
+		dag_call<T> call(arg, options);
+		struct reset {
+			dag_call<T> * & a;
+			~reset() { a = nullptr; }
+		} guard = { active };
+		active = &call;
+		return compute();
+	}
+	if (!active->applies(arg, options) || !active->count())
+		return compute();
+	if (const T * r = active->find(e))
+		return *r;
+	T r = compute();
+	active->insert(e, r);
+	return r;
+}
+
+/** Differentiates expressions with respect to one symbol, remembering the
+ *  derivative of every node.  A node occurring many times, in one or in
+ *  several expressions, is differentiated once and all derivatives built
+ *  from it share the result.  Factors and terms not depending on the symbol
+ *  are skipped. */
+class dag_derivative {
+public:
+	dag_derivative(const symbol & s) : x(s) { }
+
+	ex operator()(const ex & e);
+
+	/** Whether e depends on the symbol. */
+	bool depends(const ex & e);
+
+private:
+	symbol x;
+	exmap derivatives;
+	std::map<ex, bool, ex_is_less> dependence;
+};
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_DAG_H__
@@ -32,6 +32,8 @@
 #include "function.h"
 #include "symbol.h"
 #include "relational.h"
+#include "dag.h"
+#include "integral.h"
 #include "utils.h"
 
 #include <iostream>
@@ -81,7 +83,30 @@ ex ex::expand(unsigned options) const
 		return bp->expand(options);
 }
 
-/** Compute partial derivative of an expression.
+namespace {
+
+// the active top-level calls of the recursive operations, see dag_call
+thread_local dag_call<ex> * diff_call = nullptr;
+thread_local dag_call<ex> * subs_call = nullptr;
+thread_local dag_call<ex> * map_call = nullptr;
+thread_local dag_call<bool> * has_call = nullptr;
+
+} // anonymous namespace
+
+/** Evaluate numerically.  Integrals contained in the expression are
+ *  computed first, several at a time, see evalf_integrals().
+ *
+ *  @param level  cut-off in recursive evaluation
+ *  @param parent  Python parent of the results, or nullptr for the default */
+ex ex::evalf(int level, PyObject* parent) const
+{
+	if (bp->nops() == 0)
+		return bp->evalf(level, parent);
+	return evalf_integrals(*this, level, parent);
+}
+
+/** Compute partial derivative of an expression.  Derivatives of shared
+ *  subexpressions of large expressions are computed once.
  *
  *  @param s  symbol by which the expression is derived
  *  @param nth  order of derivative (default 1)
@@ -90,8 +115,40 @@ ex ex::diff(const symbol & s, unsigned nth) const
 {
 	if (!nth)
 		return *this;
-	else
+	else if (nth > 1 || bp->nops() == 0)
 		return bp->diff(s, nth);
+	else
+		return dag_apply(diff_call, *this, &s, 0, [&]{ return bp->diff(s, 1); });
+}
+
+/** Test for occurrence of a pattern.  An object 'has' a pattern if it
+ *  matches the pattern itself or one of the children 'has' it.  Shared
+ *  subexpressions of large expressions are searched once. */
+bool ex::has(const ex & pattern, unsigned options) const
+{
+	if (bp->nops() == 0)
+		return bp->has(pattern, options);
+	return dag_apply(has_call, *this, &pattern, options, [&]{ return bp->has(pattern, options); });
+}
+
+/** Substitute objects in an expression (syntactic substitution) and return
+ *  the result as a new expression.  Shared subexpressions of large
+ *  expressions are substituted once. */
+ex ex::subs(const exmap & m, unsigned options) const
+{
+	if (bp->nops() == 0)
+		return bp->subs(m, options);
+	return dag_apply(subs_call, *this, &m, options, [&]{ return bp->subs(m, options); });
+}
+
+/** Apply f to the operands of the expression, one level only.  When a pure
+ *  f applies itself recursively to a large expression, the result for a
+ *  shared subexpression is computed once. */
+ex ex::map(map_function & f) const
+{
+	if (bp->nops() == 0 || !f.is_pure())
+		return bp->map(f);
+	return dag_apply(map_call, *this, &f, 0, [&]{ return bp->map(f); });
 }
 
 /** Check whether expression matches a specified pattern. */
@@ -139,7 +196,7 @@ ex ex::subs(const lst & ls, const lst & lr, unsigned options) const
 	if (!(options & subs_options::pattern_is_product))
 		options |= subs_options::pattern_is_not_product;
 
-	return bp->subs(m, options);
+	return subs(m, options);
 }
 
 /** Substitute objects in an expression (syntactic substitution) and return
@@ -160,7 +217,7 @@ ex ex::subs(const ex & e, unsigned options) const
 		else
 			options |= subs_options::pattern_is_not_product;
 
-		return bp->subs(m, options);
+		return subs(m, options);
 
 	} else if (e.info(info_flags::list)) {
 
@@ -182,7 +239,7 @@ ex ex::subs(const ex & e, unsigned options) const
 		if (!(options & subs_options::pattern_is_product))
 			options |= subs_options::pattern_is_not_product;
 
-		return bp->subs(m, options);
+		return subs(m, options);
 
 	} else
 		throw(std::invalid_argument("ex::subs(ex): argument must be a relation_equal or a list"));
@@ -126,8 +126,7 @@ public:
 
 	// evaluation
 	ex eval(int level = 0) const { return bp->eval(level); }
-	ex evalf(int level = 0, PyObject* parent=nullptr) const 
-	{ return bp->evalf(level, parent); }
+	ex evalf(int level = 0, PyObject* parent=nullptr) const;
 	ex evalm() const { return bp->evalm(); }
 	ex eval_ncmul(const exvector & v) const { return bp->eval_ncmul(v); }
 	ex eval_integ() const { return bp->eval_integ(); }
@@ -159,7 +158,7 @@ public:
 	ex imag_part() const { return bp->imag_part(); }
 
 	// pattern matching
-	bool has(const ex & pattern, unsigned options = 0) const { return bp->has(pattern, options); }
+	bool has(const ex & pattern, unsigned options = 0) const;
 	bool find(const ex & pattern, lst & found) const;
 	bool match(const ex & pattern) const;
 	bool match(const ex & pattern, lst & repl_lst) const { return bp->match(pattern, repl_lst); }
@@ -170,7 +169,7 @@ public:
 	ex subs(const ex & e, unsigned options = 0) const;
 
 	// function mapping
-	ex map(map_function & f) const { return bp->map(f); }
+	ex map(map_function & f) const;
 	ex map(ex (*f)(const ex & e)) const;
 
 	// visitors and tree traversal
@@ -789,11 +788,6 @@ inline bool is_zero(const ex & thisex)
 inline void swap(ex & e1, ex & e2)
 { e1.swap(e2); }
 
-inline ex ex::subs(const exmap & m, unsigned options) const
-{
-	return bp->subs(m, options);
-}
-
 inline ex subs(const ex & thisex, const exmap & m, unsigned options = 0)
 { return thisex.subs(m, options); }
 
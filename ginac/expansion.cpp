@@ -0,0 +1,310 @@
+/** @file expansion.cpp
+ *
+ *  Expansion of expressions a chunk of terms at a time. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "expansion.h"
+#include "add.h"
+#include "mul.h"
+#include "numeric.h"
+#include "operators.h"
+#include "power.h"
+#include "utils.h"
+
+#include <vector>
+
+namespace GiNaC {
+
+/** Produces the terms of a sum one after the other, and can be restarted.
+ *  Derived classes compute some terms at a time, which are handed out
+ *  before the next ones are computed. */
+class term_source {
+public:
+	term_source(unsigned opt) : options(opt), pos(0) { }
+	virtual ~term_source() { }
+
+	/** Store the next term in t.
+	 *  @return false if there is none left */
+	bool next(ex & t)
+	{
+		while (pos == pending.size()) {
+			pending.clear();
+			pos = 0;
+			if (!produce())
+				return false;
+		}
+		t = pending[pos++];
+		return true;
+	}
+
+	void reset()
+	{
+		pending.clear();
+		pos = 0;
+		restart();
+	}
+
+protected:
+	/** Append the next terms to pending.
+	 *  @return false if there are no more */
+	virtual bool produce() = 0;
+	virtual void restart() = 0;
+
+	/** Append the terms of the expansion of e to pending. */
+	void emit(const ex & e)
+	{
+		const ex expanded = e.expand(options);
+		if (is_exactly_a<add>(expanded)) {
+			for (size_t i=0; i<expanded.nops(); ++i)
+				pending.push_back(expanded.op(i));
+		} else if (!expanded.is_zero())
+			pending.push_back(expanded);
+	}
+
+	unsigned options;
+	exvector pending;
+	size_t pos;
+};
+
+namespace {
+
+/** Terms of an expression which is expanded as a whole. */
+class leaf_source : public term_source {
+public:
+	leaf_source(const ex & e, unsigned opt) : term_source(opt), value(e), done(false) { }
+
+protected:
+	bool produce() override
+	{
+		if (done)
+			return false;
+		emit(value);
+		done = true;
+		return true;
+	}
+	void restart() override { done = false; }
+
+	ex value;
+	bool done;
+};
+
+/** Terms of the summands of a sum, one summand after the other. */
+class sum_source : public term_source {
+public:
+	sum_source(std::vector<std::unique_ptr<term_source>> && s, unsigned opt)
+	  : term_source(opt), summands(std::move(s)), current(0) { }
+
+protected:
+	bool produce() override
+	{
+		ex t;
+		for (; current<summands.size(); ++current)
+			if (summands[current]->next(t)) {
+				pending.push_back(t);
+				return true;
+			}
+		return false;
+	}
+	void restart() override
+	{
+		for (auto & s : summands)
+			s->reset();
+		current = 0;
+	}
+
+	std::vector<std::unique_ptr<term_source>> summands;
+	size_t current;
+};
+
+/** Products of one term of each factor, running through the terms of the
+ *  last factor first.  The factors are restarted instead of holding their
+ *  terms. */
+class product_source : public term_source {
+public:
+	product_source(std::vector<std::unique_ptr<term_source>> && f, unsigned opt)
+	  : term_source(opt), factors(std::move(f)), current(factors.size()), started(false), finished(false) { }
+
+protected:
+	bool produce() override
+	{
+		if (!advance())
+			return false;
+		emit((new mul(current))->setflag(status_flags::dynallocated));
+		return true;
+	}
+	void restart() override
+	{
+		for (auto & f : factors)
+			f->reset();
+		started = finished = false;
+	}
+
+	bool advance()
+	{
+		if (finished)
+			return false;
+		if (!started) {
+			started = true;
+			for (size_t i=0; i<factors.size(); ++i)
+				if (!factors[i]->next(current[i])) {
+					finished = true;
+					return false;
+				}
+			return true;
+		}
+		for (size_t i=factors.size(); i-->0; ) {
+			if (factors[i]->next(current[i]))
+				return true;
+			factors[i]->reset();
+			factors[i]->next(current[i]);
+		}
+		finished = true;
+		return false;
+	}
+
+	std::vector<std::unique_ptr<term_source>> factors;
+	exvector current;
+	bool started, finished;
+};
+
+/** Terms of (b_0 + ... + b_(m-1))^n, as in power::expand_add().  The
+ *  exponents k_0, ..., k_(m-1) summing up to n run through all
+ *  compositions of n, the last exponent fastest. */
+class power_source : public term_source {
+public:
+	power_source(const ex & sum, long n_, unsigned opt)
+	  : term_source(opt), n(n_)
+	{
+		for (size_t i=0; i<sum.nops(); ++i)
+			base.push_back(sum.op(i));
+		restart();
+	}
+
+protected:
+	bool produce() override
+	{
+		if (done)
+			return false;
+
+		// the term prod b_l^k_l with the multinomial coefficient
+		// n!/(k_0! ... k_(m-1)!), computed as a product of binomials
+		const size_t m = base.size();
+		exvector term;
+		term.reserve(m + 1);
+		numeric coeff = *_num1_p;
+		long left = n;
+		for (size_t l=0; l<m; ++l) {
+			if (k[l] != 0)
+				term.push_back(power(base[l], k[l]));
+			coeff *= binomial(left, k[l]);
+			left -= k[l];
+		}
+		term.push_back(coeff);
+		emit((new mul(term))->setflag(status_flags::dynallocated));
+
+		// next composition: take one from the last nonzero exponent
+		// before the last position and move it, together with the last
+		// exponent, to the position right of it
+		size_t l = m - 1;
+		while (l > 0 && k[l-1] == 0)
+			--l;
+		if (l == 0) {
+			done = true;
+			return true;
+		}
+		--l;
+		--k[l];
+		const long rest = k[m-1] + 1;
+		k[m-1] = 0;
+		k[l+1] = rest;
+		return true;
+	}
+	void restart() override
+	{
+		k.assign(base.size(), 0);
+		if (!base.empty())
+			k[0] = n;
+		done = base.empty();
+	}
+
+	/** Binomial coefficient by exact multiplications and divisions. */
+	static numeric binomial(long r, long s)
+	{
+		numeric result = *_num1_p;
+		for (long i=1; i<=s; ++i)
+			result = result * numeric(r - s + i) / numeric(i);
+		return result;
+	}
+
+	exvector base;
+	long n;
+	std::vector<long> k;
+	bool done;
+};
+
+std::unique_ptr<term_source> make_source(const ex & e, unsigned options)
+{
+	if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+		std::vector<std::unique_ptr<term_source>> parts;
+		for (size_t i=0; i<e.nops(); ++i)
+			parts.push_back(make_source(e.op(i), options));
+		if (is_exactly_a<add>(e))
+			return std::unique_ptr<term_source>(new sum_source(std::move(parts), options));
+		return std::unique_ptr<term_source>(new product_source(std::move(parts), options));
+	}
+	if (is_exactly_a<power>(e) && e.op(1).info(info_flags::posint)) {
+		const ex basis = e.op(0).expand(options);
+		if (is_exactly_a<add>(basis))
+			return std::unique_ptr<term_source>(new power_source(basis,
+				ex_to<numeric>(e.op(1)).to_long(), options));
+	}
+	return std::unique_ptr<term_source>(new leaf_source(e, options));
+}
+
+} // anonymous namespace
+
+/** Prepare the expansion of e.  Sums, products and positive integer
+ *  powers of sums are taken apart here; the bases of the powers are
+ *  expanded, everything else is expanded when its terms are needed.
+ *
+ *  @param e  expression
+ *  @param options  see expand_options, as for ex::expand() */
+expansion::expansion(const ex & e, unsigned options)
+  : source(make_source(e, options))
+{
+}
+
+expansion::~expansion()
+{
+}
+
+bool expansion::next(exvector & chunk, size_t n)
+{
+	chunk.clear();
+	ex t;
+	while (chunk.size() < n && source->next(t))
+		chunk.push_back(t);
+	return !chunk.empty();
+}
+
+void expansion::reset()
+{
+	source->reset();
+}
+
+} // namespace GiNaC
@@ -0,0 +1,70 @@
+/** @file expansion.h
+ *
+ *  Interface to the expansion of expressions a chunk of terms at a time. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_EXPANSION_H__
+#define __GINAC_EXPANSION_H__
+
+#include "ex.h"
+
+#include <memory>
+
+namespace GiNaC {
+
+class term_source;
+
+/** The terms of the expanded form of an expression, produced a chunk at a
+ *  time.  Products are multiplied out and positive integer powers of sums
+ *  are expanded by the multinomial theorem, one term after the other, so
+ *  only the expanded factors and bases are held, never the whole sum.
+ *
+ *  The sum of all terms equals e.expand(options), but like terms are not
+ *  collected, so a monomial may occur several times.  For instance, the
+ *  coefficient of some monomials can be accumulated with bounded memory:
+ *
+ *  @code
+ *  expansion terms((x+y+z)*pow(x+2*y+z+1, 40));
+ *  exvector chunk;
+ *  ex c = 0;
+ *  while (terms.next(chunk))
+ *      for (const auto & t : chunk)
+ *          c += t.coeff(x, 5);
+ *  @endcode */
+class expansion {
+public:
+	expansion(const ex & e, unsigned options = 0);
+	~expansion();
+
+	/** Replace the contents of chunk by the next at most n terms.
+	 *  @return false if all terms have been produced before */
+	bool next(exvector & chunk, size_t n = 1024);
+
+	/** Start again with the first term. */
+	void reset();
+
+private:
+	expansion(const expansion &) = delete;
+	expansion & operator=(const expansion &) = delete;
+
+	std::unique_ptr<term_source> source;
+};
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_EXPANSION_H__
@@ -44,6 +44,14 @@ public:
 	};
 };
 
+/** Flags to control print_csrc_function(). */
+class codegen_options {
+public:
+	enum {
+		array_arguments = 0x0001        ///< pass the arguments in one array
+	};
+};
+
 /** Flags to control the behavior of subs(). */
 class subs_options {
 public:
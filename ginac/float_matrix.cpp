@@ -0,0 +1,346 @@
+/** @file float_matrix.cpp
+ *
+ *  Implementation of dense matrices of machine floating point numbers. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "py_funcs.h"
+#include "float_matrix.h"
+#include "matrix.h"
+#include "numeric.h"
+#include "utils.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace GiNaC {
+
+//////////
+// kernels
+//////////
+
+/** The one kernel everything is built on: y[0..n) -= a*x[0..n). */
+template <typename T>
+static inline void row_update(unsigned n, const T & a, const T * x, T * y)
+{
+	for (unsigned i=0; i<n; ++i)
+		y[i] -= a*x[i];
+}
+
+static inline void row_update(unsigned n, const double & a, const double * x, double * y)
+{
+	unsigned i = 0;
+#if defined(__AVX__)
+	const __m256d va = _mm256_set1_pd(a);
+	for (; i+4<=n; i+=4) {
+		__m256d vy = _mm256_loadu_pd(y+i);
+		vy = _mm256_sub_pd(vy, _mm256_mul_pd(va, _mm256_loadu_pd(x+i)));
+		_mm256_storeu_pd(y+i, vy);
+	}
+#elif defined(__SSE2__)
+	const __m128d va = _mm_set1_pd(a);
+	for (; i+2<=n; i+=2) {
+		__m128d vy = _mm_loadu_pd(y+i);
+		vy = _mm_sub_pd(vy, _mm_mul_pd(va, _mm_loadu_pd(x+i)));
+		_mm_storeu_pd(y+i, vy);
+	}
+#endif
+	for (; i<n; ++i)
+		y[i] -= a*x[i];
+}
+
+/** Product of matrices, accumulated row by row: the i-th row of the
+ *  result is the sum of the rows of other weighted by row i of *this. */
+template <typename T>
+float_matrix<T> float_matrix<T>::mul(const float_matrix & other) const
+{
+	float_matrix<T> prod(row, other.col);
+	for (unsigned i=0; i<row; ++i) {
+		T * prow = prod[i];
+		const T * arow = (*this)[i];
+		for (unsigned k=0; k<col; ++k) {
+			if (arow[k] == T(0))
+				continue;
+			row_update(other.col, T(-arow[k]), other[k], prow);
+		}
+	}
+	return prod;
+}
+
+/** LU factorization with partial pivoting, in place.  Afterwards the
+ *  strictly lower part holds L (with unit diagonal) and the rest holds U,
+ *  such that row i of L*U is row perm[i] of the original matrix.
+ *
+ *  @return false if the matrix is singular */
+template <typename T>
+bool float_matrix<T>::lu_factor(std::vector<unsigned> & perm, int & sign)
+{
+	const unsigned n = row;
+	perm.resize(n);
+	for (unsigned i=0; i<n; ++i)
+		perm[i] = i;
+	sign = 1;
+
+	for (unsigned k=0; k<n; ++k) {
+		unsigned p = k;
+		double pmax = std::abs((*this)[k][k]);
+		for (unsigned i=k+1; i<n; ++i) {
+			double a = std::abs((*this)[i][k]);
+			if (a > pmax) {
+				pmax = a;
+				p = i;
+			}
+		}
+		if (pmax == 0.0)
+			return false;
+		if (p != k) {
+			std::swap_ranges((*this)[p], (*this)[p]+n, (*this)[k]);
+			std::swap(perm[p], perm[k]);
+			sign = -sign;
+		}
+		const T * krow = (*this)[k];
+		for (unsigned i=k+1; i<n; ++i) {
+			T * irow = (*this)[i];
+			if (irow[k] == T(0))
+				continue;
+			const T l = irow[k] / krow[k];
+			irow[k] = l;
+			row_update(n-k-1, l, krow+k+1, irow+k+1);
+		}
+	}
+	return true;
+}
+
+/** Solve the systems given by the columns of b with a factorization
+ *  computed by lu_factor().  All columns are processed together, so the
+ *  substitution steps are row updates of length b.cols(). */
+template <typename T>
+void float_matrix<T>::lu_solve(const std::vector<unsigned> & perm, float_matrix & b) const
+{
+	const unsigned n = row;
+	const unsigned p = b.col;
+	float_matrix<T> x(n, p);
+	for (unsigned i=0; i<n; ++i)
+		std::copy(b[perm[i]], b[perm[i]]+p, x[i]);
+
+	// forward substitution with L
+	for (unsigned i=1; i<n; ++i) {
+		const T * lrow = (*this)[i];
+		for (unsigned k=0; k<i; ++k)
+			if (lrow[k] != T(0))
+				row_update(p, lrow[k], x[k], x[i]);
+	}
+
+	// back substitution with U
+	for (int i=n-1; i>=0; --i) {
+		const T * urow = (*this)[i];
+		T * xrow = x[i];
+		for (unsigned k=i+1; k<n; ++k)
+			if (urow[k] != T(0))
+				row_update(p, urow[k], x[k], xrow);
+		const T d = T(1) / urow[i];
+		for (unsigned c=0; c<p; ++c)
+			xrow[c] *= d;
+	}
+	b = std::move(x);
+}
+
+template class float_matrix<double>;
+template class float_matrix<std::complex<double>>;
+
+//////////
+// conversion from and to class matrix
+//////////
+
+/** Find out whether all entries of A are machine floats.  Exact zeros are
+ *  accepted, as they arise from the default constructor of matrix. */
+float_kind get_float_kind(const matrix & A)
+{
+	bool has_float = false;
+	bool has_complex = false;
+	for (unsigned r=0; r<A.rows(); ++r) {
+		for (unsigned c=0; c<A.cols(); ++c) {
+			const ex & e = A(r,c);
+			if (!is_exactly_a<numeric>(e))
+				return float_kind::none;
+			const numeric & x = ex_to<numeric>(e);
+			if (x.is_double()) {
+				has_float = true;
+				continue;
+			}
+			if (x.is_pyobject()) {
+				PyObject * o = x.to_pyobject();
+				bool is_float = PyFloat_Check(o);
+				bool is_complex = PyComplex_Check(o);
+				Py_DECREF(o);
+				if (!is_float && !is_complex)
+					return float_kind::none;
+				has_float = true;
+				has_complex |= is_complex;
+				continue;
+			}
+			if (!x.is_zero())
+				return float_kind::none;
+		}
+	}
+	if (!has_float)
+		return float_kind::none;
+	return has_complex ? float_kind::complex : float_kind::real;
+}
+
+static void to_float(const numeric & x, double & d)
+{
+	d = x.to_double();
+}
+
+static void to_float(const numeric & x, std::complex<double> & z)
+{
+	if (x.is_pyobject()) {
+		PyObject * o = x.to_pyobject();
+		if (PyComplex_Check(o)) {
+			z = std::complex<double>(PyComplex_RealAsDouble(o),
+			                         PyComplex_ImagAsDouble(o));
+			Py_DECREF(o);
+			return;
+		}
+		Py_DECREF(o);
+	}
+	z = x.to_double();
+}
+
+static ex from_float(double d)
+{
+	return numeric(d);
+}
+
+static ex from_float(const std::complex<double> & z)
+{
+	if (z.imag() == 0.0)
+		return numeric(z.real());
+	return numeric(PyComplex_FromDoubles(z.real(), z.imag()));
+}
+
+template <typename T>
+static float_matrix<T> to_float_matrix(const matrix & A)
+{
+	float_matrix<T> F(A.rows(), A.cols());
+	for (unsigned r=0; r<A.rows(); ++r)
+		for (unsigned c=0; c<A.cols(); ++c)
+			to_float(ex_to<numeric>(A(r,c)), F[r][c]);
+	return F;
+}
+
+template <typename T>
+static matrix from_float_matrix(const float_matrix<T> & F)
+{
+	matrix A(F.rows(), F.cols());
+	for (unsigned r=0; r<F.rows(); ++r)
+		for (unsigned c=0; c<F.cols(); ++c)
+			A(r,c) = from_float(F[r][c]);
+	return A;
+}
+
+//////////
+// entry points for class matrix
+//////////
+
+bool float_matrix_mul(const matrix & A, const matrix & B, matrix & C)
+{
+	float_kind ka = get_float_kind(A);
+	if (ka == float_kind::none)
+		return false;
+	float_kind kb = get_float_kind(B);
+	if (kb == float_kind::none)
+		return false;
+
+	typedef std::complex<double> cdouble;
+	if (ka == float_kind::real && kb == float_kind::real)
+		C = from_float_matrix(to_float_matrix<double>(A).mul(to_float_matrix<double>(B)));
+	else
+		C = from_float_matrix(to_float_matrix<cdouble>(A).mul(to_float_matrix<cdouble>(B)));
+	return true;
+}
+
+template <typename T>
+static ex float_determinant(float_matrix<T> F)
+{
+	std::vector<unsigned> perm;
+	int sign;
+	if (!F.lu_factor(perm, sign))
+		return from_float(T(0));
+	T det = T(sign);
+	for (unsigned k=0; k<F.rows(); ++k)
+		det *= F[k][k];
+	return from_float(det);
+}
+
+bool float_matrix_determinant(const matrix & A, ex & det)
+{
+	switch (get_float_kind(A)) {
+		case float_kind::real:
+			det = float_determinant(to_float_matrix<double>(A));
+			return true;
+		case float_kind::complex:
+			det = float_determinant(to_float_matrix<std::complex<double>>(A));
+			return true;
+		default:
+			return false;
+	}
+}
+
+template <typename T>
+static bool float_solve(float_matrix<T> F, float_matrix<T> b, matrix & X)
+{
+	std::vector<unsigned> perm;
+	int sign;
+	if (!F.lu_factor(perm, sign))
+		return false;
+	F.lu_solve(perm, b);
+	X = from_float_matrix(b);
+	return true;
+}
+
+/** Solve A*X == B for square A.  Singular systems are left to the generic
+ *  code, which knows how to deal with free parameters. */
+bool float_matrix_solve(const matrix & A, const matrix & B, matrix & X)
+{
+	if (A.rows() != A.cols() || A.rows() != B.rows())
+		return false;
+	float_kind ka = get_float_kind(A);
+	if (ka == float_kind::none)
+		return false;
+	float_kind kb = get_float_kind(B);
+	if (kb == float_kind::none) {
+		// the exact unit matrix of inverse() is the only exact right hand
+		// side taken, other ones keep their exact entries on the generic path
+		for (unsigned r=0; r<B.rows(); ++r)
+			for (unsigned c=0; c<B.cols(); ++c)
+				if (!(r == c ? B(r,c).is_equal(_ex1) : B(r,c).is_zero()))
+					return false;
+	}
+
+	typedef std::complex<double> cdouble;
+	if (ka != float_kind::complex && kb != float_kind::complex)
+		return float_solve(to_float_matrix<double>(A), to_float_matrix<double>(B), X);
+	return float_solve(to_float_matrix<cdouble>(A), to_float_matrix<cdouble>(B), X);
+}
+
+} // namespace GiNaC
@@ -0,0 +1,74 @@
+/** @file float_matrix.h
+ *
+ *  Interface to dense matrices of machine floating point numbers, used
+ *  internally by class matrix when all its entries are floats. */
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GINAC_FLOAT_MATRIX_H__
+#define __GINAC_FLOAT_MATRIX_H__
+
+#include <complex>
+#include <vector>
+
+namespace GiNaC {
+
+class ex;
+class matrix;
+
+/** Which kind of machine floats the entries of a matrix can be mapped to
+ *  without loss. */
+enum class float_kind {
+	none,         ///< some entry is symbolic, exact or of higher precision
+	real,         ///< all entries are doubles (or exact zeros)
+	complex       ///< all entries are double precision, some complex
+};
+
+/** Dense row-major matrix of doubles or complex doubles.  The rows are
+ *  contiguous so that the elimination and multiplication kernels stream
+ *  through memory and vectorize. */
+template <typename T>
+class float_matrix {
+public:
+	float_matrix(unsigned r, unsigned c) : row(r), col(c), m(r*c) {}
+
+	unsigned rows() const { return row; }
+	unsigned cols() const { return col; }
+	T * operator[](unsigned r) { return &m[r*col]; }
+	const T * operator[](unsigned r) const { return &m[r*col]; }
+
+	float_matrix mul(const float_matrix & other) const;
+	bool lu_factor(std::vector<unsigned> & perm, int & sign);
+	void lu_solve(const std::vector<unsigned> & perm, float_matrix & b) const;
+
+protected:
+	unsigned row;     ///< number of rows
+	unsigned col;     ///< number of columns
+	std::vector<T> m; ///< representation (row after row, row-major)
+};
+
+float_kind get_float_kind(const matrix & A);
+
+// Entry points used by class matrix.  They return false if the float
+// kernel does not apply, in which case the caller takes the generic path.
+bool float_matrix_mul(const matrix & A, const matrix & B, matrix & C);
+bool float_matrix_determinant(const matrix & A, ex & det);
+bool float_matrix_solve(const matrix & A, const matrix & B, matrix & X);
+
+} // namespace GiNaC
+
+#endif // ndef __GINAC_FLOAT_MATRIX_H__
@@ -42,16 +42,142 @@
 #include <stdexcept>
 #include <list>
 #include <limits>
+#include <map>
 #ifdef DO_GINAC_ASSERT
 #  include <typeinfo>
 #endif
 
 namespace GiNaC {
 
+//////////
+// dispatch table
+//////////
+
+namespace {
+
+/** The fields of function_options needed on every eval() and evalf(),
+ *  packed together per serial.  Python functions additionally keep their
+ *  bound _eval_/_evalf_ methods and a spare argument tuple.
+ *
+ *  The setters of function_options which change these fields, and copying
+ *  or assigning whole options, bump options_generation, and the entries are refreshed lazily from the
+ *  options when they are used next.  register_new() sizes the table, so
+ *  it never grows during a lookup and references into it stay valid. */
+struct function_dispatch {
+	unsigned long generation;
+	eval_funcp eval_f;
+	evalf_funcp evalf_f;
+	unsigned nparams;
+	unsigned python_func;
+	bool eval_use_exvector_args;
+	bool evalf_use_exvector_args;
+	bool evalf_params_first;
+	bool use_remember;
+	bool has_symmetry;
+	PyObject* eval_method;
+	PyObject* evalf_method;
+	PyObject* eval_args;
+	PyObject* evalf_args;
+};
+
+unsigned long options_generation = 1;
+
+std::vector<function_options> & function_registry()
+{
+	static auto rf = new std::vector<function_options>;
+	return *rf;
+}
+
+std::vector<function_dispatch> & dispatch_table()
+{
+	static auto dt = new std::vector<function_dispatch>;
+	return *dt;
+}
+
+const function_dispatch & get_dispatch(unsigned serial)
+{
+	GINAC_ASSERT(serial<dispatch_table().size());
+	function_dispatch & d = dispatch_table()[serial];
+	if (d.generation == options_generation)
+		return d;
+
+	const function_options & opt = function_registry()[serial];
+	if (d.eval_method != nullptr && (void*)d.eval_f != (void*)opt.eval_f) {
+		Py_DECREF(d.eval_method);
+		d.eval_method = nullptr;
+	}
+	if (d.evalf_method != nullptr && (void*)d.evalf_f != (void*)opt.evalf_f) {
+		Py_DECREF(d.evalf_method);
+		d.evalf_method = nullptr;
+	}
+	d.eval_f = opt.eval_f;
+	d.evalf_f = opt.evalf_f;
+	d.nparams = opt.nparams;
+	d.python_func = opt.python_func;
+	d.eval_use_exvector_args = opt.eval_use_exvector_args;
+	d.evalf_use_exvector_args = opt.evalf_use_exvector_args;
+	d.evalf_params_first = opt.evalf_params_first;
+	d.use_remember = opt.use_remember;
+	d.has_symmetry = !opt.symtree.is_zero();
+	d.generation = options_generation;
+	return d;
+}
+
+/** The bound method 'name' of a Python function object, looked up once. */
+PyObject* python_method(PyObject* & cached, void* obj, const char* name)
+{
+	if (cached == nullptr)
+		cached = PyObject_GetAttrString((PyObject*)obj, name);
+	return cached;
+}
+
+/** A tuple of the arguments, reusing the spare tuple if possible. */
+PyObject* python_args(PyObject* & spare, const exvector & v)
+{
+	PyObject* t = spare;
+	spare = nullptr;
+	if (t == nullptr || PyTuple_GET_SIZE(t) != (Py_ssize_t)v.size()) {
+		Py_XDECREF(t);
+		return py_funcs.exvector_to_PyTuple(v);
+	}
+	for (size_t i=0; i<v.size(); ++i)
+		PyTuple_SET_ITEM(t, i, py_funcs.ex_to_pyExpression(v[i]));
+	return t;
+}
+
+/** Keep the argument tuple as spare if the Python function did not hold
+ *  on to it. */
+void release_python_args(PyObject* & spare, PyObject* t)
+{
+	if (spare != nullptr || Py_REFCNT(t) != 1) {
+		Py_DECREF(t);
+		return;
+	}
+	for (Py_ssize_t i=0; i<PyTuple_GET_SIZE(t); ++i) {
+		PyObject* item = PyTuple_GET_ITEM(t, i);
+		PyTuple_SET_ITEM(t, i, nullptr);
+		Py_XDECREF(item);
+	}
+	spare = t;
+}
+
+} // anonymous namespace
+
 //////////
 // helper class function_options
 //////////
 
+function_options::generation_bump::generation_bump(const generation_bump &)
+{
+	++options_generation;
+}
+
+function_options::generation_bump & function_options::generation_bump::operator=(const generation_bump &)
+{
+	++options_generation;
+	return *this;
+}
+
 function_options::function_options()
 {
 	initialize();
@@ -281,12 +407,14 @@ function_options& function_options::eval_func(eval_funcp_exvector e)
 {
 	eval_use_exvector_args = true;
 	eval_f = eval_funcp(e);
+	++options_generation;
 	return *this;
 }
 function_options& function_options::evalf_func(evalf_funcp_exvector ef)
 {
 	evalf_use_exvector_args = true;
 	evalf_f = evalf_funcp(ef);
+	++options_generation;
 	return *this;
 }
 function_options& function_options::conjugate_func(conjugate_funcp_exvector c)
@@ -339,12 +467,14 @@ function_options& function_options::eval_func(PyObject* e)
 {
 	python_func |= eval_python_f;
 	eval_f = eval_funcp(e);
+	++options_generation;
 	return *this;
 }
 function_options& function_options::evalf_func(PyObject* ef)
 {
 	python_func |= evalf_python_f;
 	evalf_f = evalf_funcp(ef);
+	++options_generation;
 	return *this;
 }
 function_options& function_options::conjugate_func(PyObject* c)
@@ -402,6 +532,7 @@ function_options & function_options::set_return_type(unsigned rt, tinfo_t rtt)
 function_options & function_options::do_not_evalf_params()
 {
 	evalf_params_first = false;
+	++options_generation;
 	return *this;
 }
 
@@ -419,6 +550,7 @@ function_options & function_options::remember(unsigned size,
 	remember_size = size;
 	remember_assoc_size = assoc_size;
 	remember_strategy = strategy;
+	++options_generation;
 	return *this;
 }
 
@@ -431,11 +563,13 @@ function_options & function_options::overloaded(unsigned o)
 function_options & function_options::set_symmetry(const symmetry & s)
 {
 	symtree = s;
+	++options_generation;
 	return *this;
 }
 	
 void function_options::test_and_set_nparams(unsigned n)
 {
+	++options_generation;
 	if (nparams==0) {
 		nparams = n;
 	} else if (nparams!=n) {
@@ -582,7 +716,7 @@ function::function(const archive_node &n, lst &sym_lst) : inherited(n, sym_lst)
 	if (n.find_string("name", s)) {
 		unsigned int ser = 0;
 		unsigned int nargs = seq.size();
-                for (const auto & elem : registered_functions()) {
+                for (const auto & elem : function_registry()) {
 			if (s == elem.name && nargs == elem.nparams) {
 				serial = ser;
 				return;
@@ -614,14 +748,14 @@ ex function::unarchive(const archive_node &n, lst &sym_lst)
 void function::archive(archive_node &n) const
 {
 	inherited::archive(n);
-	GINAC_ASSERT(serial < registered_functions().size());
+	GINAC_ASSERT(serial < function_registry().size());
 	// we use Python's pickling mechanism to archive symbolic functions
 	// with customized methods defined in Python. Symbolic functions
 	// defined from c++ or those without custom methods are archived
 	// directly, without calling Python. The python_func flag indicates if
 	// we should use the python unpickling mechanism, or the regular
 	// unarchiving for c++ functions.
-	unsigned python_func = registered_functions()[serial].python_func;
+	unsigned python_func = function_registry()[serial].python_func;
 	if (python_func) {
 		n.add_unsigned("python", python_func);
 		// find the corresponding SFunction object
@@ -639,7 +773,7 @@ void function::archive(archive_node &n) const
 		delete pickled;
 	} else {
 		n.add_unsigned("python", 0);
-		n.add_string("name", registered_functions()[serial].name);
+		n.add_string("name", function_registry()[serial].name);
 	}
 }
 
@@ -651,7 +785,7 @@ void function::archive(archive_node &n) const
 
 void function::print(const print_context & c, unsigned level) const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
+	GINAC_ASSERT(serial<function_registry().size());
 	// Dynamically dispatch on print_context type
 	const print_context_class_info *pc_info = &c.get_class_info();
 	if (serial >= static_cast<unsigned>(py_funcs.py_get_ginac_serial())) {
@@ -696,7 +830,7 @@ void function::print(const print_context & c, unsigned level) const
 		Py_DECREF(args);
 	} else {
 
-		const function_options &opt = registered_functions()[serial];
+		const function_options &opt = function_registry()[serial];
 		const std::vector<print_funcp> &pdt = opt.print_dispatch_table;
 
 
@@ -780,14 +914,16 @@ ex function::eval(int level) const
 		return function(serial,evalchildren(level));
 	}
 
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	// a copy, the calls below may register functions and move the table
+	const function_dispatch d = get_dispatch(serial);
 
 	// Canonicalize argument order according to the symmetry properties
-	if (seq.size() > 1 && !(opt.symtree.is_zero())) {
+	if (seq.size() > 1 && d.has_symmetry) {
+		const ex & symtree = function_registry()[serial].symtree;
 		exvector v = seq;
-		GINAC_ASSERT(is_a<symmetry>(opt.symtree));
-		int sig = canonicalize(v.begin(), ex_to<symmetry>(opt.symtree));
+		GINAC_ASSERT(is_a<symmetry>(symtree));
+		int sig = canonicalize(v.begin(), ex_to<symmetry>(symtree));
 		if (sig != std::numeric_limits<int>::max()) {
 			// Something has changed while sorting arguments, more evaluations later
 			if (sig == 0)
@@ -796,28 +932,34 @@ ex function::eval(int level) const
 		}
 	}
 
-	if (opt.eval_f==nullptr) {
+	if (d.eval_f==nullptr) {
 		return this->hold();
 	}
 
-	bool use_remember = opt.use_remember;
+	bool use_remember = d.use_remember;
 	ex eval_result;
 	if (use_remember && lookup_remember_table(eval_result)) {
 		return eval_result;
 	}
 	current_serial = serial;
 
-	if (opt.python_func & function_options::eval_python_f) {
+	if (d.python_func & function_options::eval_python_f) {
 		// convert seq to a PyTuple of Expressions
-		PyObject* args = py_funcs.exvector_to_PyTuple(seq);
+		function_dispatch & pd = dispatch_table()[serial];
+		PyObject* method = python_method(pd.eval_method, (void*)d.eval_f, "_eval_");
+		if (!method) {
+			throw(std::runtime_error("function::eval(): python function has no _eval_ method"));
+		}
+		PyObject* args = python_args(pd.eval_args, seq);
 		// call opt.eval_f with this list
-		PyObject* pyresult = PyObject_CallMethod((PyObject*)opt.eval_f,
-				const_cast<char*>("_eval_"), const_cast<char*>("O"), args);
-		Py_DECREF(args);
+		PyObject* pyresult = PyObject_Call(method, args, nullptr);
+		// the table may have grown during the call
+		release_python_args(dispatch_table()[serial].eval_args, args);
 		if (!pyresult) { 
 			throw(std::runtime_error("function::eval(): python function raised exception"));
 		}
 		if ( pyresult == Py_None ) {
+			Py_DECREF(pyresult);
 			return this->hold();
 		}
 		// convert output Expression to an ex
@@ -827,19 +969,19 @@ ex function::eval(int level) const
 			throw(std::runtime_error("function::eval(): python function (Expression_to_ex) raised exception"));
 		}
 	}
-	else if (opt.eval_use_exvector_args)
-		eval_result = ((eval_funcp_exvector)(opt.eval_f))(seq);
+	else if (d.eval_use_exvector_args)
+		eval_result = ((eval_funcp_exvector)(d.eval_f))(seq);
 	else
-	switch (opt.nparams) {
+	switch (d.nparams) {
 		// the following lines have been generated for max. 14 parameters
 	case 1:
-		eval_result = ((eval_funcp_1)(opt.eval_f))(seq[1-1]);
+		eval_result = ((eval_funcp_1)(d.eval_f))(seq[1-1]);
 		break;
 	case 2:
-		eval_result = ((eval_funcp_2)(opt.eval_f))(seq[1-1], seq[2-1]);
+		eval_result = ((eval_funcp_2)(d.eval_f))(seq[1-1], seq[2-1]);
 		break;
 	case 3:
-		eval_result = ((eval_funcp_3)(opt.eval_f))(seq[1-1], seq[2-1], seq[3-1]);
+		eval_result = ((eval_funcp_3)(d.eval_f))(seq[1-1], seq[2-1], seq[3-1]);
 		break;
 
 		// end of generated lines
@@ -854,34 +996,70 @@ ex function::eval(int level) const
 
 ex function::evalf(int level, PyObject* kwds) const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	// a copy, the calls below may register functions and move the table
+	const function_dispatch d = get_dispatch(serial);
+
+	const bool eval_params = level != 1 && d.evalf_params_first;
+	if (eval_params && level == -max_recursion_level)
+		throw(std::runtime_error("max recursion level reached"));
+
+	if (d.evalf_f==nullptr) {
+		if (!eval_params)
+			return function(serial,seq).hold();
+		exvector eseq;
+		eseq.reserve(seq.size());
+		for (const auto & elem : seq)
+			eseq.push_back(elem.evalf(level-1, kwds));
+		return function(serial,eseq).hold();
+	}
+
+	// C++ functions with few parameters get their evaluated arguments
+	// in a buffer on the stack
+	if (!(d.python_func & function_options::evalf_python_f)
+	    && !d.evalf_use_exvector_args && d.nparams <= 3
+	    && d.nparams == seq.size()) {
+		const evalf_funcp f = d.evalf_f;
+		ex a[3];
+		for (size_t i=0; i<seq.size(); ++i)
+			a[i] = eval_params ? seq[i].evalf(level-1, kwds) : seq[i];
+		current_serial = serial;
+		switch (seq.size()) {
+		// the following lines have been generated for max. 14 parameters
+		case 1:
+			return ((evalf_funcp_1)(f))(a[1-1], kwds);
+		case 2:
+			return ((evalf_funcp_2)(f))(a[1-1], a[2-1], kwds);
+		case 3:
+			return ((evalf_funcp_3)(f))(a[1-1], a[2-1], a[3-1], kwds);
+		// end of generated lines
+		}
+		throw(std::logic_error("function::evalf(): invalid nparams"));
+	}
 
 	// Evaluate children first
 	exvector eseq;
-	if (level == 1 || !(opt.evalf_params_first))
+	if (!eval_params)
 		eseq = seq;
-	else if (level == -max_recursion_level)
-		throw(std::runtime_error("max recursion level reached"));
 	else {
 		eseq.reserve(seq.size());
-		--level;
-                for (const auto & elem : seq)
-			eseq.push_back(elem.evalf(level, kwds));
+		for (const auto & elem : seq)
+			eseq.push_back(elem.evalf(level-1, kwds));
 	}
 
-	if (opt.evalf_f==nullptr) {
-		return function(serial,eseq).hold();
-	}
 	current_serial = serial;
-	if (opt.python_func & function_options::evalf_python_f) { 
+	if (d.python_func & function_options::evalf_python_f) { 
 		// convert seq to a PyTuple of Expressions
-		PyObject* args = py_funcs.exvector_to_PyTuple(eseq);
+		function_dispatch & pd = dispatch_table()[serial];
+		PyObject* method = python_method(pd.evalf_method, (void*)d.evalf_f, "_evalf_");
+		if (!method) {
+			throw(std::runtime_error("function::evalf(): python function has no _evalf_ method"));
+		}
+		PyObject* args = python_args(pd.evalf_args, eseq);
 		// call opt.evalf_f with this list
-		PyObject* pyresult = PyEval_CallObjectWithKeywords(
-			PyObject_GetAttrString((PyObject*)opt.evalf_f,
-				"_evalf_"), args, kwds);
-		Py_DECREF(args);
+		PyObject* pyresult = PyEval_CallObjectWithKeywords(method, args, kwds);
+		// the table may have grown during the call
+		release_python_args(dispatch_table()[serial].evalf_args, args);
 		if (!pyresult) { 
 			throw(std::runtime_error("function::evalf(): python function raised exception"));
 		}
@@ -893,20 +1071,157 @@ ex function::evalf(int level, PyObject* kwds) const
 		}
 		return result;
 	}
-	if (opt.evalf_use_exvector_args)
-		return ((evalf_funcp_exvector)(opt.evalf_f))(seq, kwds);
-	switch (opt.nparams) {
-		// the following lines have been generated for max. 14 parameters
-	case 1:
-		return ((evalf_funcp_1)(opt.evalf_f))(eseq[1-1], kwds);
-	case 2:
-		return ((evalf_funcp_2)(opt.evalf_f))(eseq[1-1], eseq[2-1], kwds);
-	case 3:
-		return ((evalf_funcp_3)(opt.evalf_f))(eseq[1-1], eseq[2-1], eseq[3-1], kwds);
+	if (d.evalf_use_exvector_args)
+		return ((evalf_funcp_exvector)(d.evalf_f))(seq, kwds);
+	throw(std::logic_error("function::evalf(): invalid nparams"));
+}
 
-		// end of generated lines
+namespace {
+
+/** False for applications of functions declared with
+ *  do_not_evalf_params(), whose evalf gets the arguments as they are. */
+bool evalf_params_first(const ex & e)
+{
+	return !is_exactly_a<function>(e)
+	    || function_registry()[ex_to<function>(e).get_serial()].evalf_params_first;
+}
+
+/** Replaces subexpressions by their numerical values computed so far,
+ *  except in the arguments of functions which do not evaluate them. */
+struct replace_evaluated : public map_function {
+	const exmap & values;
+	explicit replace_evaluated(const exmap & v) : values(v) {}
+	ex operator()(const ex & e) override
+	{
+		auto it = values.find(e);
+		if (it != values.end())
+			return it->second;
+		if (e.nops() == 0 || !evalf_params_first(e))
+			return e;
+		return e.map(*this);
 	}
-	throw(std::logic_error("function::evalf(): invalid nparams"));
+	bool is_pure() const override { return true; }
+};
+
+/** Applications of functions with a Python evalf method, grouped by
+ *  their nesting depth and serial.  Applications at depth 1 have no such
+ *  applications in their arguments. */
+typedef std::map<std::pair<int, unsigned>, exvector> batch_map;
+
+typedef std::map<ex, int, ex_is_less> depth_map;
+
+int collect_python_evalf(const ex & e, batch_map & batches, depth_map & seen)
+{
+	auto it = seen.find(e);
+	if (it != seen.end())
+		return it->second;
+
+	int depth = 0;
+	if (evalf_params_first(e))
+		for (size_t i=0; i<e.nops(); ++i)
+			depth = std::max(depth, collect_python_evalf(e.op(i), batches, seen));
+	if (is_exactly_a<function>(e)) {
+		const unsigned ser = ex_to<function>(e).get_serial();
+		const function_options & opt = function_registry()[ser];
+		if (opt.evalf_f != nullptr
+		    && (opt.python_func & function_options::evalf_python_f)) {
+			++depth;
+			batches[std::make_pair(depth, ser)].push_back(e);
+		}
+	}
+	seen[e] = depth;
+	return depth;
+}
+
+/** Owns a new reference, released on destruction. */
+struct py_ref {
+	explicit py_ref(PyObject* o) : obj(o) {}
+	~py_ref() { Py_XDECREF(obj); }
+	py_ref(const py_ref &) = delete;
+	py_ref & operator=(const py_ref &) = delete;
+	PyObject* obj;
+};
+
+ex pyresult_to_ex(PyObject* pyresult)
+{
+	ex result = py_funcs.pyExpression_to_ex(pyresult);
+	if (PyErr_Occurred()) {
+		throw(std::runtime_error("function::evalf_batched(): python function (pyExpression_to_ex) raised exception"));
+	}
+	return result;
+}
+
+} // anonymous namespace
+
+/** Numerically evaluate e like e.evalf(0, parent), but call each
+ *  Python-defined evalf function only once for all of its (distinct)
+ *  applications in e.  If the Python object has a method _evalf_batch_,
+ *  it is passed the list of all argument tuples and must return the list
+ *  of results; otherwise its _evalf_ method is looked up once and called
+ *  for each tuple.  Nested applications are evaluated innermost first. */
+ex function::evalf_batched(const ex & e, PyObject* parent)
+{
+	batch_map batches;
+	depth_map depths;
+	collect_python_evalf(e, batches, depths);
+
+	exmap values;
+	replace_evaluated replace(values);
+	for (const auto & batch : batches) {
+		const unsigned ser = batch.first.second;
+		const function_options & opt = function_registry()[ser];
+		const exvector & apps = batch.second;
+
+		// evaluate the arguments, using the values of inner applications,
+		// unless the function takes them unevaluated
+		py_ref arglist(PyList_New(apps.size()));
+		for (size_t i=0; i<apps.size(); ++i) {
+			exvector eseq;
+			eseq.reserve(apps[i].nops());
+			for (size_t j=0; j<apps[i].nops(); ++j) {
+				if (opt.evalf_params_first)
+					eseq.push_back(replace(apps[i].op(j)).evalf(0, parent));
+				else
+					eseq.push_back(apps[i].op(j));
+			}
+			PyList_SET_ITEM(arglist.obj, i, py_funcs.exvector_to_PyTuple(eseq));
+		}
+
+		current_serial = ser;
+		PyObject* obj = (PyObject*)opt.evalf_f;
+		if (PyObject_HasAttrString(obj, "_evalf_batch_")) {
+			py_ref method(PyObject_GetAttrString(obj, "_evalf_batch_"));
+			if (!method.obj) {
+				throw(std::runtime_error("function::evalf_batched(): python function raised exception"));
+			}
+			py_ref args(PyTuple_Pack(1, arglist.obj));
+			py_ref pyresult(PyEval_CallObjectWithKeywords(method.obj, args.obj, parent));
+			if (!pyresult.obj) {
+				throw(std::runtime_error("function::evalf_batched(): python function raised exception"));
+			}
+			if (!PyList_Check(pyresult.obj) || PyList_GET_SIZE(pyresult.obj) != (Py_ssize_t)apps.size()) {
+				throw(std::runtime_error("function::evalf_batched(): _evalf_batch_ must return a list with one result per argument tuple"));
+			}
+			for (size_t i=0; i<apps.size(); ++i)
+				values[apps[i]] = pyresult_to_ex(PyList_GET_ITEM(pyresult.obj, i));
+		} else {
+			py_ref method(PyObject_GetAttrString(obj, "_evalf_"));
+			if (!method.obj) {
+				throw(std::runtime_error("function::evalf_batched(): python function raised exception"));
+			}
+			for (size_t i=0; i<apps.size(); ++i) {
+				py_ref pyresult(PyEval_CallObjectWithKeywords(method.obj,
+						PyList_GET_ITEM(arglist.obj, i), parent));
+				if (!pyresult.obj) {
+					throw(std::runtime_error("function::evalf_batched(): python function raised exception"));
+				}
+				values[apps[i]] = pyresult_to_ex(pyresult.obj);
+			}
+		}
+	}
+
+	// what remains are C++ functions and arithmetic
+	return replace(e).evalf(0, parent);
 }
 
 long function::calchash() const
@@ -938,8 +1253,8 @@ ex function::thiscontainer(std::unique_ptr<exvector> vp) const
  *  @see ex::series */
 ex function::series(const relational & r, int order, unsigned options) const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 
 	if (opt.series_f==nullptr) {
 		return basic::series(r, order);
@@ -1013,8 +1328,8 @@ ex function::series(const relational & r, int order, unsigned options) const
 /** Implementation of ex::subs for functions. */
 ex function::subs(const exmap & m, unsigned options) const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options & opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options & opt = function_registry()[serial];
 
 	if (opt.python_func & function_options::subs_python_f) {
 		// convert seq to a PyTuple of Expressions
@@ -1041,8 +1356,8 @@ ex function::subs(const exmap & m, unsigned options) const
 /** Implementation of ex::conjugate for functions. */
 ex function::conjugate() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options & opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options & opt = function_registry()[serial];
 
 	if (opt.conjugate_f==nullptr) {
 		return conjugate_function(*this).hold();
@@ -1088,8 +1403,8 @@ ex function::conjugate() const
 /** Implementation of ex::real_part for functions. */
 ex function::real_part() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options & opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options & opt = function_registry()[serial];
 
 	if (opt.real_part_f==nullptr)
 		return basic::real_part();
@@ -1132,8 +1447,8 @@ ex function::real_part() const
 /** Implementation of ex::imag_part for functions. */
 ex function::imag_part() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options & opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options & opt = function_registry()[serial];
 
 	if (opt.imag_part_f==nullptr)
 		return basic::imag_part();
@@ -1187,8 +1502,8 @@ ex function::derivative(const symbol & s) const
 		// Order Term function only differentiates the argument
 		return Order(seq[0].diff(s));
 		*/
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 
 	// Check if we need to apply chain rule
 	if (!opt.apply_chain_rule) {
@@ -1298,8 +1613,8 @@ bool function::match_same_type(const basic & other) const
 
 unsigned function::return_type() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 
 	if (opt.use_return_type) {
 		// Return type was explicitly specified
@@ -1316,8 +1631,8 @@ unsigned function::return_type() const
 
 tinfo_t function::return_type_tinfo() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 
 	if (opt.use_return_type) {
 		// Return type was explicitly specified
@@ -1346,8 +1661,8 @@ tinfo_t function::return_type_tinfo() const
 
 ex function::pderivative(unsigned diff_param) const // partial differentiation
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 	
 	// No derivative defined? Then return abstract derivative object
 	if (opt.derivative_f == nullptr)
@@ -1397,8 +1712,8 @@ ex function::pderivative(unsigned diff_param) const // partial differentiation
 
 ex function::power(const ex & power_param) const // power of function
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	const function_options &opt = registered_functions()[serial];
+	GINAC_ASSERT(serial<function_registry().size());
+	const function_options &opt = function_registry()[serial];
 	
 	// No derivative defined? Then return abstract derivative object
 	if (opt.power_f == nullptr)
@@ -1447,8 +1762,13 @@ ex function::power(const ex & power_param) const // power of function
 
 std::vector<function_options> & function::registered_functions()
 {
-	static auto  rf = new std::vector<function_options>;
-	return *rf;
+	return function_registry();
+}
+
+void function_options::set_python_func()
+{
+	python_func = true;
+	++options_generation;
 }
 
 bool function::lookup_remember_table(ex & result) const
@@ -1466,7 +1786,7 @@ void function::store_remember_table(ex const & result) const
 unsigned function::register_new(function_options const & opt)
 {
 	size_t same_name = 0;
-	for (auto & elem : registered_functions()) {
+	for (auto & elem : function_registry()) {
 		if (elem.name==opt.name) {
 			++same_name;
 		}
@@ -1485,16 +1805,18 @@ unsigned function::register_new(function_options const & opt)
 		//std::cerr << "WARNING: function name " << opt.name
 		//          << " already in use!" << std::endl;
 	}
-	registered_functions().push_back(opt);
+	function_registry().push_back(opt);
+	dispatch_table().resize(function_registry().size(), function_dispatch());
 	if (opt.use_remember) {
 		remember_table::remember_tables().
-			push_back(remember_table(opt.remember_size,
-			                         opt.remember_assoc_size,
-			                         opt.remember_strategy));
+			emplace_back(opt.remember_size,
+			             opt.remember_assoc_size,
+			             opt.remember_strategy,
+			             opt.name);
 	} else {
-		remember_table::remember_tables().push_back(remember_table());
+		remember_table::remember_tables().emplace_back();
 	}
-	return registered_functions().size()-1;
+	return function_registry().size()-1;
 }
 
 /** Find serial number of function by name and number of parameters.
@@ -1502,7 +1824,7 @@ unsigned function::register_new(function_options const & opt)
 unsigned function::find_function(const std::string &name, unsigned nparams)
 {
 	unsigned serial = 0;
-        for (const auto & elem : registered_functions()) {
+        for (const auto & elem : function_registry()) {
 		if (elem.get_name() == name && elem.get_nparams() == nparams)
 			return serial;
 		++serial;
@@ -1513,8 +1835,8 @@ unsigned function::find_function(const std::string &name, unsigned nparams)
 /** Return the print name of the function. */
 std::string function::get_name() const
 {
-	GINAC_ASSERT(serial<registered_functions().size());
-	return registered_functions()[serial].name;
+	GINAC_ASSERT(serial<function_registry().size());
+	return function_registry()[serial].name;
 }
 
 void function::set_domain(unsigned d)
@@ -230,8 +230,9 @@ public:
 
 	std::string get_name() const { return name; }
 	unsigned get_nparams() const { return nparams; }
+	bool applies_chain_rule() const { return apply_chain_rule; }
 
-	void set_python_func() { python_func = true; }
+	void set_python_func();
 
 	void set_print_latex_func(PyObject* f);
 	void set_print_dflt_func(PyObject* f);
@@ -297,6 +298,15 @@ public:
 	unsigned functions_with_same_name;
 
 	ex symtree;
+
+	/** Copying or assigning options, e.g. registered_functions()[s] = opt,
+	 *  bumps the generation of the cached dispatch entries like the
+	 *  setters do. */
+	struct generation_bump {
+		generation_bump() {}
+		generation_bump(const generation_bump &);
+		generation_bump & operator=(const generation_bump &);
+	} bump;
 };
 
 
@@ -318,6 +328,8 @@ class function : public exprseq
 #endif // def __MAKECINT__
 
 	friend class remember_table_entry;
+	friend class compiled_ex;
+	friend class dag_derivative;
 	// friend class remember_table_list;
 	// friend class remember_table;
 
@@ -373,6 +385,7 @@ public:
 	static unsigned register_new(function_options const & opt);
 	static unsigned current_serial;
 	static unsigned find_function(const std::string &name, unsigned nparams);
+	static ex evalf_batched(const ex & e, PyObject* parent=nullptr);
 	unsigned get_serial() const {return serial;}
 	std::string get_name() const;
 	unsigned get_domain() const { return domain; }
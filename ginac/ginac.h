@@ -60,6 +60,12 @@
 #include "operators.h"
 
 #include "assume.h"
+#include "cache.h"
+#include "compiled.h"
+#include "cse.h"
+#include "codegen.h"
+#include "dag.h"
+#include "expansion.h"
 
 #include "idx.h"
 #include "indexed.h"
@@ -161,6 +161,10 @@ template<> inline bool is_the_function<zeta_SERIAL>(const ex& x)
 	return is_the_function<zeta1_SERIAL>(x) || is_the_function<zeta2_SERIAL>(x);
 }
 
+/** Save the multiple zeta values evaluated so far, or load precomputed ones. */
+void save_mzv_table(std::ostream & os);
+void load_mzv_table(std::istream & is);
+
 class stieltjes1_SERIAL { public: static unsigned serial; };
 template<typename T1>
 inline function stieltjes(const T1& p1) {
@@ -230,6 +234,13 @@ DECLARE_FUNCTION_2P(binomial)
 /** Hermite polynomial. */
 DECLARE_FUNCTION_2P(hermite)
 
+/** Values of the Hermite polynomials H_0, ..., H_n at all points x, with
+ *  H_k(x[j]) stored in result[k*x.size()+j]. */
+void hermite_values(unsigned n, const std::vector<double> & x, std::vector<double> & result);
+
+/** The expanded Hermite polynomials H_0(x), ..., H_n(x). */
+exvector hermite_polynomials(unsigned n, const ex & x);
+
 /** Order term function (for truncated power series). */
 DECLARE_FUNCTION_1P(Order)
 
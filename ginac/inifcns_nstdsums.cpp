@@ -80,6 +80,9 @@
 #include "utils.h"
 #include "wildcard.h"
 
+#include <cmath>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
@@ -382,9 +385,142 @@ numeric S_num(int n, int p, const numeric& x);
 // }
 */
 
+// Machine precision version of the Xn tables above.  With u = -log(1-x)
+// the classical polylogs are
+//   Li_{q+1}(x) = \sum_{n=0}^\infty c_q(n) u^{n+1},  c_q(n) = X_{q-1}(n)/(n+1)!
+// and the coefficients follow from the Bernoulli numbers by
+//   c_0(n) = delta_{n,0}
+//   c_q(n) = 1/(n+1) \sum_{k=0}^n B_{n-k}/(n-k)! c_{q-1}(k).
+// The series converges for |u| < 2*Pi.
+//
+// The table is filled lazily, doubling the number of terms when a sum
+// needs more, so that all evaluations share the precomputation.  It can be
+// used from several threads: a row is never modified once it has been
+// handed out, growing it publishes a longer copy.
+class polylog_table
+{
+public:
+	typedef std::vector<double> row_t;
+	typedef std::shared_ptr<const row_t> row_ptr;
+
+	// initial number of terms per row
+	static const size_t initsize = 32;
+
+	/** Return c_q(n) for at least 0 <= n < terms. */
+	row_ptr row(size_t q, size_t terms);
+
+private:
+	void fill_bernoulli(size_t terms);
+
+	std::mutex mtx;
+	// B_n/n!
+	row_t bn;
+	std::vector<row_ptr> rows;
+};
+
+void polylog_table::fill_bernoulli(size_t terms)
+{
+	static const double small_bernoulli[] = { 1.0/6, -1.0/30, 1.0/42,
+		-1.0/30, 5.0/66, -691.0/2730, 7.0/6 };
+	for (size_t n=bn.size(); n<terms; ++n) {
+		if (n < 2) {
+			bn.push_back(n == 0 ? 1 : -0.5);
+		} else if (n & 1) {
+			bn.push_back(0);
+		} else if (n <= 14) {
+			bn.push_back(small_bernoulli[n/2-1] / std::tgamma(n+1));
+		} else {
+			// B_n/n! = (-1)^(n/2+1) 2 zeta(n) / (2 Pi)^n
+			double z = 1;
+			for (int k=2; k<=10; ++k)
+				z += std::pow(double(k), -double(n));
+			const double b = 2 * z / std::pow(2*M_PI, double(n));
+			bn.push_back((n/2) & 1 ? b : -b);
+		}
+	}
+}
+
+polylog_table::row_ptr polylog_table::row(size_t q, size_t terms)
+{
+	std::lock_guard<std::mutex> guard(mtx);
+	size_t size = initsize;
+	while (size < terms)
+		size *= 2;
+	if (q < rows.size() && rows[q]->size() >= size)
+		return rows[q];
+
+	fill_bernoulli(size);
+	for (size_t l=0; l<=q; ++l) {
+		if (l < rows.size() && rows[l]->size() >= size)
+			continue;
+		std::shared_ptr<row_t> c(new row_t(size));
+		for (size_t n=0; n<size; ++n) {
+			if (l == 0) {
+				(*c)[n] = (n == 0);
+				continue;
+			}
+			const row_t & prev = *rows[l-1];
+			double sum = 0;
+			for (size_t k=0; k<=n; ++k)
+				sum += bn[n-k] * prev[k];
+			(*c)[n] = sum / (n+1);
+		}
+		if (l < rows.size())
+			rows[l] = c;
+		else
+			rows.push_back(c);
+	}
+	return rows[q];
+}
+
+// Li(n,x) in machine precision for real x with |log(1-x)| <= 5, i.e.
+// -147 < x < 0.993, where the series in u needs at most a few hundred
+// terms.  Returns false if the argument is outside of that range.
+bool Lin_double(int n, double x, double& result)
+{
+	static polylog_table table;
+	const size_t maxterms = 512;
+
+	if (!(x < 1))
+		return false;
+	const double u = -std::log1p(-x);
+	if (!(std::fabs(u) <= 5))
+		return false;
+
+	polylog_table::row_ptr c = table.row(n-1, polylog_table::initsize);
+	double res = 0;
+	double upow = u;
+	double prev = 1;
+	for (size_t i=0; ; ++i) {
+		if (i == c->size()) {
+			if (i >= maxterms)
+				return false;
+			c = table.row(n-1, 2*i);
+		}
+		const double term = (*c)[i] * upow;
+		res += term;
+		// every other coefficient may vanish, so look at two terms
+		if (std::fabs(term) + std::fabs(prev) <= std::fabs(res) * 1e-17)
+			break;
+		prev = term;
+		upow *= u;
+	}
+	result = res;
+	return true;
+}
+
 // helper function for classical polylog Li
 numeric Lin_numeric(const numeric& n, const numeric& x, PyObject* parent)
 {
+	// machine precision arguments are done here, unless a different
+	// parent was asked for
+	double xd, res;
+	if (is_machine_precision(parent)
+	    && n.is_pos_integer() && n <= 64
+	    && x.get_machine_double(xd)
+	    && Lin_double(n.to_int(), xd, res))
+		return res;
+
   return Li2(x, n, parent);
 
 // 	if (n == 1) {
@@ -6,6 +6,8 @@
  */
 
 #include "inifcns.h"
+#include "add.h"
+#include "cache.h"
 #include "ex.h"
 #include "constant.h"
 #include "infinity.h"
@@ -18,16 +20,187 @@
 #include "pseries.h"
 #include "utils.h"
 
+#include <cmath>
+#include <vector>
+
 namespace GiNaC {
 
+//////////
+// Families given by a three-term recurrence
+//////////
+
+namespace {
+
+// Orthogonal polynomials p_k defined by the three-term recurrence
+//   p_0(x) = 1,  p_{k+1}(x) = (a_k x + b_k) p_k(x) - c_k p_{k-1}(x).
+// A family only has to supply a_k, b_k and c_k.  The values at many
+// points are computed degree by degree for all points at once, the
+// inner loop runs over contiguous doubles and is vectorized by the
+// compiler.  The expanded polynomials are kept as coefficient vectors
+// which are extended lazily when a higher degree is asked for.
+class orthopoly_recurrence : public managed_cache
+{
+public:
+	explicit orthopoly_recurrence(const std::string & n) : managed_cache(n) {}
+
+	virtual void coefficients(unsigned k, numeric & a, numeric & b, numeric & c) const = 0;
+
+	void values(unsigned n, const std::vector<double> & x, std::vector<double> & result) const;
+	std::vector<numeric> expanded(unsigned n);
+	ex polynomial(unsigned n, const ex & x);
+
+	void evict(size_t amount) override;
+	void flush() override;
+
+protected:
+	static size_t entry_size(const std::vector<numeric> & p)
+	{
+		return sizeof(p) + p.size() * (sizeof(numeric) + 2*sizeof(void *));
+	}
+
+	// coefficients of x^0, x^1, ... of p_0, p_1, ...
+	std::vector<std::vector<numeric>> polys;
+};
+
+/** Store p_k(x[j]) for all k <= n in result[k*x.size()+j]. */
+void orthopoly_recurrence::values(unsigned n, const std::vector<double> & x, std::vector<double> & result) const
+{
+	const size_t m = x.size();
+	result.assign((n+1) * m, 1.0);
+	numeric a, b, c;
+	for (unsigned k=0; k<n; ++k) {
+		coefficients(k, a, b, c);
+		const double ad = a.to_double(), bd = b.to_double(), cd = c.to_double();
+		const double * p = result.data() + k*m;
+		double * q = result.data() + (k+1)*m;
+		if (k == 0) {
+			for (size_t j=0; j<m; ++j)
+				q[j] = ad * x[j] + bd;
+		} else {
+			const double * pm = result.data() + (k-1)*m;
+			for (size_t j=0; j<m; ++j)
+				q[j] = (ad * x[j] + bd) * p[j] - cd * pm[j];
+		}
+	}
+}
+
+/** Coefficients of x^0, ..., x^n of p_n. */
+std::vector<numeric> orthopoly_recurrence::expanded(unsigned n)
+{
+	size_t grown = 0;
+	numeric a, b, c;
+	while (polys.size() <= n) {
+		const unsigned k = polys.size();
+		std::vector<numeric> p(k+1, *_num0_p);
+		if (k == 0) {
+			p[0] = *_num1_p;
+		} else {
+			coefficients(k-1, a, b, c);
+			const std::vector<numeric> & p1 = polys[k-1];
+			for (unsigned i=0; i<k; ++i) {
+				p[i+1] += a * p1[i];
+				p[i] += b * p1[i];
+			}
+			if (k >= 2) {
+				const std::vector<numeric> & p2 = polys[k-2];
+				for (unsigned i=0; i<k-1; ++i)
+					p[i] -= c * p2[i];
+			}
+		}
+		grown += entry_size(p);
+		polys.push_back(p);
+	}
+	// accounting may evict the polynomials just computed
+	std::vector<numeric> result = polys[n];
+	account(grown);
+	return result;
+}
+
+ex orthopoly_recurrence::polynomial(unsigned n, const ex & x)
+{
+	const std::vector<numeric> p = expanded(n);
+	exvector terms;
+	for (unsigned i=0; i<p.size(); ++i)
+		if (!p[i].is_zero())
+			terms.push_back(power(x, numeric(i)) * p[i]);
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+// highest degrees go first, the lower ones are needed to extend the table
+void orthopoly_recurrence::evict(size_t amount)
+{
+	size_t freed = 0;
+	while (freed < amount && !polys.empty()) {
+		freed += entry_size(polys.back());
+		polys.pop_back();
+	}
+	account(-static_cast<std::ptrdiff_t>(freed));
+}
+
+void orthopoly_recurrence::flush()
+{
+	evict(memory_size());
+}
+
+} // anonymous namespace
+
 //////////
 // Hermite polynomials H_n(x)
 //////////
 
+namespace {
+
+class hermite_recurrence : public orthopoly_recurrence
+{
+public:
+	hermite_recurrence() : orthopoly_recurrence("Hermite polynomials") {}
+
+	// H_{k+1}(x) = 2x H_k(x) - 2k H_{k-1}(x)
+	void coefficients(unsigned k, numeric & a, numeric & b, numeric & c) const override
+	{
+		a = *_num2_p;
+		b = *_num0_p;
+		c = numeric(2*k);
+	}
+};
+
+hermite_recurrence & hermite_table()
+{
+	// never destroyed, like the cache manager
+	static auto t = new hermite_recurrence;
+	return *t;
+}
+
+} // anonymous namespace
+
+void hermite_values(unsigned n, const std::vector<double> & x, std::vector<double> & result)
+{
+	hermite_table().values(n, x, result);
+}
+
+exvector hermite_polynomials(unsigned n, const ex & x)
+{
+	exvector result;
+	result.reserve(n+1);
+	for (unsigned k=0; k<=n; ++k)
+		result.push_back(hermite_table().polynomial(k, x));
+	return result;
+}
+
 static ex hermite_evalf(const ex& n, const ex& x, PyObject* parent)
 {
         numeric numn = ex_to<numeric>(n);
         numeric numx = ex_to<numeric>(x);
+        // machine precision values by the recurrence, unless they overflow
+        double xd;
+        if (is_machine_precision(parent)
+            and numn.is_nonneg_integer() and numn < 1024
+            and numx.get_machine_double(xd)) {
+                std::vector<double> values;
+                hermite_table().values(numn.to_int(), std::vector<double>(1, xd), values);
+                if (std::isfinite(values.back()))
+                        return numeric(values.back());
+        }
         std::vector<numeric> numveca, numvecb;
         numveca.push_back(numn / *_num_2_p);
         numveca.push_back(*_num1_2_p + (numn / *_num_2_p));
@@ -101,7 +101,7 @@ static ex exp_eval(const ex & x)
         };
 
 	ex x_red;
-        if (has_pi_and_py(x)) { // true if x contains Pi and Python objects
+        if (x.has(Pi) and has_pi_and_py(x)) { // true if x contains Pi and Python objects
                                 // like I. To make this check should be faster
                                 // than the following
 
@@ -148,6 +148,40 @@ static ex exp_deriv(const ex & x, unsigned deriv_param)
 	return exp(x);
 }
 
+/** False if the series of e in s certainly is no Taylor series with
+ *  numeric coefficients, because e contains other symbols, constants or
+ *  powers with non-integer exponents.  Saves computing a series which
+ *  pseries::exp_series() and pseries::log_series() cannot use. */
+static bool may_be_numeric_taylor(const ex & e, const ex & s)
+{
+	if (is_exactly_a<symbol>(e))
+		return e.is_equal(s);
+	if (is_exactly_a<constant>(e))
+		return false;
+	if (is_exactly_a<power>(e) && !e.op(1).info(info_flags::integer))
+		return false;
+	for (size_t i=0; i<e.nops(); ++i)
+		if (!may_be_numeric_taylor(e.op(i), s))
+			return false;
+	return true;
+}
+
+static ex exp_series(const ex & arg,
+                     const relational & rel,
+                     int order,
+                     unsigned options)
+{
+	// Series with numeric coefficients are exponentiated directly, which
+	// for high orders is much faster than repeated differentiation.
+	if (may_be_numeric_taylor(arg, rel.lhs())) {
+		const ex argser = arg.series(rel, order, options);
+		if (is_exactly_a<pseries>(argser)
+		    and ex_to<pseries>(argser).is_numeric_taylor())
+			return ex_to<pseries>(argser).exp_series(order);
+	}
+	throw do_taylor();  // caught by function::series()
+}
+
 static ex exp_real_part(const ex & x)
 {
 	return exp(GiNaC::real_part(x))*cos(GiNaC::imag_part(x));
@@ -225,6 +259,7 @@ static ex exp_conjugate(const ex & x)
 REGISTER_FUNCTION(exp, eval_func(exp_eval).
                        evalf_func(exp_evalf).
                        derivative_func(exp_deriv).
+                       series_func(exp_series).
                        real_part_func(exp_real_part).
                        imag_part_func(exp_imag_part).
                        power_func(exp_power).
@@ -343,6 +378,8 @@ static ex log_series(const ex &arg,
 		if (!argser.is_terminating() || argser.nops()!=1) {
 			// in this case n more (or less) terms are needed
 			// (sadly, to generate them, we have to start from the beginning)
+			if (n == 0 && argser.is_numeric_taylor())
+				return argser.log_series(order);
 			if (n == 0 && coeff == 1) {
 				epvector epv;
 				ex acc = (new pseries(rel, epv))->setflag(status_flags::dynallocated);
@@ -378,6 +415,15 @@ static ex log_series(const ex &arg,
 		seq.push_back(expair(Order(_ex1), order));
 		return series(replarg - I*Pi + pseries(rel, seq), rel, order);
 	}
+
+	// Away from the branch point a series with numeric coefficients is
+	// handled directly, like in exp_series().
+	if (may_be_numeric_taylor(arg, rel.lhs())) {
+		const ex argser = arg.series(rel, order, options);
+		if (is_exactly_a<pseries>(argser)
+		    and ex_to<pseries>(argser).is_numeric_taylor())
+			return ex_to<pseries>(argser).log_series(order);
+	}
 	throw do_taylor();  // caught by function::series()
 }
 
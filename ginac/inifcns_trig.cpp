@@ -41,12 +41,8 @@ namespace GiNaC {
    below with each of the corresponding inverse trig function. */
 
 static bool has_pi(const ex & the_ex) {
-        if (is_exactly_a<constant>(the_ex) and ex_to<constant>(the_ex) == Pi)
-                return true;
-        for (size_t i=0; i<the_ex.nops(); ++i)
-                if (has_pi(the_ex.op(i)))
-                        return true;
-        return false;
+        // ex::has() visits shared subexpressions only once
+        return the_ex.has(Pi);
 }
 //////////
 // sine (trigonometric function)
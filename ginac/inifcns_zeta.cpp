@@ -1,5 +1,6 @@
 #include "inifcns.h"
 
+#include "cache.h"
 #include "infinity.h"
 #include "lst.h"
 #include "constant.h"
@@ -9,6 +10,12 @@
 #include "pseries.h"
 #include "utils.h"
 
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <map>
+#include <ostream>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
@@ -63,6 +70,292 @@ unsigned stieltjes1_SERIAL::serial = function::register_new(function_options("st
                                 print_func<print_latex>(stieltjes1_print_latex).
                                 overloaded(2));
 
+//////////////////////////////////////////////////////////////////////
+//
+// Multiple zeta values  zeta(x) and zeta(x,s)
+//
+// helper functions
+//
+//////////////////////////////////////////////////////////////////////
+
+
+// anonymous namespace for helper functions
+namespace {
+
+
+// performs the actual series summation for multiple polylogarithms
+// in machine precision
+double multipleLi_do_sum(const std::vector<int>& s, const std::vector<double>& x)
+{
+	const int j = s.size();
+	bool flag_accidental_zero = false;
+
+	std::vector<double> t(j);
+
+	double t0buf;
+	int q = 0;
+	do {
+		t0buf = t[0];
+		for (int step=0; step<2; ++step) {
+			q++;
+			t[j-1] = t[j-1] + std::pow(x[j-1], q) / std::pow(double(q), s[j-1]);
+			for (int k=j-2; k>=0; k--) {
+				flag_accidental_zero = (t[k+1] == 0);
+				t[k] = t[k] + t[k+1] * std::pow(x[k], q+j-1-k) / std::pow(double(q+j-1-k), s[k]);
+			}
+		}
+	} while ((t[0] != t0buf) || (t[0] == 0) || flag_accidental_zero);
+
+	return t[0];
+}
+
+
+// does Hoelder convolution. see [BBB] (7.0)
+double zeta_do_Hoelder_convolution(const std::vector<int>& m_, const std::vector<int>& s_)
+{
+	// prepare parameters
+	// holds Li arguments in [BBB] notation
+	std::vector<int> s = s_;
+	std::vector<int> m_p = m_;
+	std::vector<int> m_q;
+	// holds Li arguments in nested sums notation
+	std::vector<double> s_p(s.size(), 1.0);
+	s_p[0] = s_p[0] * 0.5;
+	// convert notations
+	int sig = 1;
+	for (size_t i=0; i<s_.size(); i++) {
+		if (s_[i] < 0) {
+			sig = -sig;
+			s_p[i] = -s_p[i];
+		}
+		s[i] = sig * std::abs(s[i]);
+	}
+	std::vector<double> s_q;
+	double signum = 1;
+
+	// first term
+	double res = multipleLi_do_sum(m_p, s_p);
+
+	// middle terms
+	do {
+
+		// change parameters
+		if (s.front() > 0) {
+			if (m_p.front() == 1) {
+				m_p.erase(m_p.begin());
+				s_p.erase(s_p.begin());
+				if (s_p.size() > 0) {
+					s_p.front() = s_p.front() * 0.5;
+				}
+				s.erase(s.begin());
+				m_q.front()++;
+			} else {
+				m_p.front()--;
+				m_q.insert(m_q.begin(), 1);
+				if (s_q.size() > 0) {
+					s_q.front() = s_q.front() * 2;
+				}
+				s_q.insert(s_q.begin(), 0.5);
+			}
+		} else {
+			if (m_p.front() == 1) {
+				m_p.erase(m_p.begin());
+				double spbuf = s_p.front();
+				s_p.erase(s_p.begin());
+				if (s_p.size() > 0) {
+					s_p.front() = s_p.front() * spbuf;
+				}
+				s.erase(s.begin());
+				m_q.insert(m_q.begin(), 1);
+				if (s_q.size() > 0) {
+					s_q.front() = s_q.front() * 4;
+				}
+				s_q.insert(s_q.begin(), 0.25);
+				signum = -signum;
+			} else {
+				m_p.front()--;
+				m_q.insert(m_q.begin(), 1);
+				if (s_q.size() > 0) {
+					s_q.front() = s_q.front() * 2;
+				}
+				s_q.insert(s_q.begin(), 0.5);
+			}
+		}
+
+		// exiting the loop
+		if (m_p.size() == 0) break;
+
+		res = res + signum * multipleLi_do_sum(m_p, s_p) * multipleLi_do_sum(m_q, s_q);
+
+	} while (true);
+
+	// last term
+	res = res + signum * multipleLi_do_sum(m_q, s_q);
+
+	return res;
+}
+
+
+// Table of the multiple zeta values and alternating Euler sums evaluated
+// so far.  The key holds the weights, negated where the sign is -1, e.g.
+// zeta(lst(3,1),lst(-1,1)) is stored under (-3,1).  Only machine precision
+// values are computed, the precision is part of the binary format such
+// that tables of other precisions are recognized when they are loaded.
+class mzv_table : public managed_cache
+{
+public:
+	typedef std::vector<int> key_t;
+	typedef std::map<key_t, double> value_map;
+
+	// precision of the values in bits
+	static const std::uint32_t precision = 53;
+
+	static mzv_table & instance()
+	{
+		// never destroyed, like the cache manager
+		static auto t = new mzv_table;
+		return *t;
+	}
+
+	double value(const std::vector<int>& m, const std::vector<int>& s)
+	{
+		key_t key(m);
+		for (size_t i=0; i<key.size(); ++i)
+			key[i] *= s[i];
+		auto it = values.find(key);
+		if (it != values.end())
+			return it->second;
+		const double v = zeta_do_Hoelder_convolution(m, s);
+		insert(key, v);
+		return v;
+	}
+
+	void insert(const key_t & key, double v)
+	{
+		auto ins = values.insert(std::make_pair(key, v));
+		if (!ins.second) {
+			ins.first->second = v;
+			return;
+		}
+		order.push_back(ins.first);
+		account(entry_size(key));
+	}
+
+	void save(std::ostream & os) const;
+	void load(std::istream & is);
+
+	void evict(size_t amount) override
+	{
+		size_t freed = 0;
+		while (freed < amount && !order.empty()) {
+			freed += entry_size(order.front()->first);
+			values.erase(order.front());
+			order.pop_front();
+		}
+		account(-static_cast<std::ptrdiff_t>(freed));
+	}
+
+	void flush() override
+	{
+		evict(memory_size());
+	}
+
+protected:
+	mzv_table() : managed_cache("multiple zeta values") {}
+
+	// map node with the key's storage, and the list node
+	static size_t entry_size(const key_t & key)
+	{
+		return sizeof(value_map::value_type) + key.size()*sizeof(int)
+		       + 7*sizeof(void *);
+	}
+
+	value_map values;
+	// insertion order, oldest values are evicted first
+	std::list<value_map::iterator> order;
+};
+
+// magic bytes at the start of the binary format
+const char mzv_magic[4] = { 'M', 'Z', 'V', '1' };
+
+// The binary format is, in the byte order of the machine: the magic
+// bytes, the precision in bits and the number of values, followed by
+// the depth, the signed weights and the value of each entry.
+void mzv_table::save(std::ostream & os) const
+{
+	const std::uint32_t prec = precision;
+	const std::uint64_t count = values.size();
+	os.write(mzv_magic, sizeof(mzv_magic));
+	os.write(reinterpret_cast<const char *>(&prec), sizeof(prec));
+	os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	for (const auto & v : values) {
+		const std::uint32_t depth = v.first.size();
+		os.write(reinterpret_cast<const char *>(&depth), sizeof(depth));
+		for (const auto & w : v.first) {
+			const std::int32_t weight = w;
+			os.write(reinterpret_cast<const char *>(&weight), sizeof(weight));
+		}
+		os.write(reinterpret_cast<const char *>(&v.second), sizeof(v.second));
+	}
+	if (!os)
+		throw std::runtime_error("save_mzv_table(): write error");
+}
+
+void mzv_table::load(std::istream & is)
+{
+	char magic[sizeof(mzv_magic)];
+	std::uint32_t prec;
+	std::uint64_t count;
+	is.read(magic, sizeof(magic));
+	is.read(reinterpret_cast<char *>(&prec), sizeof(prec));
+	is.read(reinterpret_cast<char *>(&count), sizeof(count));
+	if (!is || !std::equal(magic, magic+sizeof(magic), mzv_magic))
+		throw std::runtime_error("load_mzv_table(): not a table of multiple zeta values");
+	if (prec != precision)
+		throw std::runtime_error("load_mzv_table(): table has a different precision");
+
+	// read everything first, a truncated file leaves the table unchanged
+	std::vector<std::pair<key_t, double>> entries;
+	for (std::uint64_t i=0; i<count; ++i) {
+		std::uint32_t depth;
+		is.read(reinterpret_cast<char *>(&depth), sizeof(depth));
+		if (!is || depth == 0 || depth > 1024)
+			throw std::runtime_error("load_mzv_table(): corrupt table");
+		key_t key(depth);
+		for (auto & w : key) {
+			std::int32_t weight;
+			is.read(reinterpret_cast<char *>(&weight), sizeof(weight));
+			w = weight;
+		}
+		double v;
+		is.read(reinterpret_cast<char *>(&v), sizeof(v));
+		if (!is)
+			throw std::runtime_error("load_mzv_table(): corrupt table");
+		entries.push_back(std::make_pair(key, v));
+	}
+	for (const auto & e : entries)
+		insert(e.first, e.second);
+}
+
+
+} // end of anonymous namespace
+
+
+/** Write all multiple zeta values and alternating Euler sums evaluated so
+ *  far to a binary stream. */
+void save_mzv_table(std::ostream & os)
+{
+	mzv_table::instance().save(os);
+}
+
+/** Add the values from a binary stream written by save_mzv_table() to the
+ *  table, e.g. at startup, so that their evaluation becomes a lookup. */
+void load_mzv_table(std::istream & is)
+{
+	mzv_table::instance().load(is);
+}
+
+
 //////////////////////////////////////////////////////////////////////
 //
 // Multiple zeta values  zeta(x)
@@ -74,7 +367,7 @@ unsigned stieltjes1_SERIAL::serial = function::register_new(function_options("st
 
 static ex zeta1_evalf(const ex& x, PyObject* parent)
 {
-        /*
+	// the parameters are not evaluated beforehand, weights must stay integers
 	if (is_exactly_a<lst>(x) && (x.nops()>1)) {
 
 		// multiple zeta value
@@ -87,7 +380,7 @@ static ex zeta1_evalf(const ex& x, PyObject* parent)
 		auto it2 = r.begin();
 		do {
 			if (!(*it1).info(info_flags::posint)) {
-				return zeta(x).hold();
+				return zeta(x.evalf(0, parent)).hold();
 			}
 			*it2 = ex_to<numeric>(*it1).to_int();
 			it1++;
@@ -96,29 +389,26 @@ static ex zeta1_evalf(const ex& x, PyObject* parent)
 
 		// check for divergence
 		if (r[0] == 1) {
-			return zeta(x).hold();
+			return zeta(x.evalf(0, parent)).hold();
 		}
-
-		// decide on summation algorithm
-		// this is still a bit clumsy
-		int limit = 10;
-		if ((r[0] < limit) || ((count > 3) && (r[1] < limit/2))) {
-			return numeric(zeta_do_sum_Crandall(r));
-		} else {
-			return numeric(zeta_do_sum_simple(r));
+		if (!is_machine_precision(parent)) {
+			return zeta(x.evalf(0, parent)).hold();
 		}
-	}*/
+
+		return numeric(mzv_table::instance().value(r, std::vector<int>(count, 1))).evalf(0, parent);
+	}
 
 	// single zeta value
-	if (x == 1) {
+	const ex xf = x.evalf(0, parent);
+	if (xf == 1) {
 		return UnsignedInfinity;
-	} else	if (is_exactly_a<numeric>(x)) {
+	} else	if (is_exactly_a<numeric>(xf)) {
 		try {
-			return zeta(ex_to<numeric>(x.evalf(0, parent)));
+			return zeta(ex_to<numeric>(xf));
 		} catch (const dunno &e) { }
 	}
 
-	return zeta(x).hold();
+	return zeta(xf).hold();
 }
 
 
@@ -217,6 +507,7 @@ unsigned zeta1_SERIAL::serial = function::register_new(function_options("zeta",
                                 derivative_func(zeta1_deriv).
                                 series_func(zeta1_series).
                                 print_func<print_latex>(zeta1_print_latex).
+                                do_not_evalf_params().
                                 overloaded(2));
 
 
@@ -231,8 +522,8 @@ unsigned zeta1_SERIAL::serial = function::register_new(function_options("zeta",
 
 static ex zeta2_evalf(const ex& x, const ex& s, PyObject* parent)
 {
-        /*
-	if (is_exactly_a<lst>(x)) {
+	// the parameters are not evaluated beforehand, weights must stay integers
+	if (is_exactly_a<lst>(x) && is_exactly_a<lst>(s) && x.nops() == s.nops()) {
 
 		// alternating Euler sum
 		const int count = x.nops();
@@ -248,10 +539,10 @@ static ex zeta2_evalf(const ex& x, const ex& s, PyObject* parent)
 		auto it_swrite = si.begin();
 		do {
 			if (!(*it_xread).info(info_flags::posint)) {
-				return zeta(x, s).hold();
+				return zeta(x.evalf(0, parent), s.evalf(0, parent)).hold();
 			}
 			*it_xwrite = ex_to<numeric>(*it_xread).to_int();
-			if (*it_sread > 0) {
+			if ((*it_sread).info(info_flags::positive)) {
 				*it_swrite = 1;
 			} else {
 				*it_swrite = -1;
@@ -264,14 +555,17 @@ static ex zeta2_evalf(const ex& x, const ex& s, PyObject* parent)
 
 		// check for divergence
 		if ((xi[0] == 1) && (si[0] == 1)) {
-			return zeta(x, s).hold();
+			return zeta(x.evalf(0, parent), s.evalf(0, parent)).hold();
+		}
+		if (!is_machine_precision(parent)) {
+			return zeta(x.evalf(0, parent), s.evalf(0, parent)).hold();
 		}
 
 		// use Hoelder convolution
-		return numeric(zeta_do_Hoelder_convolution(xi, si));
-	}*/
+		return numeric(mzv_table::instance().value(xi, si)).evalf(0, parent);
+	}
 
-	return zeta(x, s).hold();
+	return zeta(x.evalf(0, parent), s.evalf(0, parent)).hold();
 }
 
 
@@ -354,6 +648,7 @@ unsigned zeta2_SERIAL::serial = function::register_new(function_options("zeta",
                                 eval_func(zeta2_eval).
                                 derivative_func(zeta2_deriv).
                                 print_func<print_latex>(zeta2_print_latex).
+                                do_not_evalf_params().
                                 overloaded(2));
 
 } // namespace GiNaC
@@ -33,6 +33,17 @@
 #include "utils.h"
 #include "operators.h"
 #include "relational.h"
+#include "cache.h"
+#include "compiled.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <exception>
+#include <list>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 using namespace std;
 
@@ -43,6 +54,14 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(integral, basic,
   print_func<print_latex>(&integral::do_print_latex))
 
 
+namespace {
+
+/** Set once an integral has been constructed, until then evalf() need not
+ *  look for integrals. */
+bool integrals_exist = false;
+
+} // anonymous namespace
+
 //////////
 // default constructor
 //////////
@@ -50,7 +69,9 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(integral, basic,
 integral::integral()
 		: inherited(&integral::tinfo_static),
 		x((new symbol())->setflag(status_flags::dynallocated))
-{}
+{
+	integrals_exist = true;
+}
 
 //////////
 // other constructors
@@ -64,6 +85,7 @@ integral::integral(ex  x_, ex  a_, ex  b_, ex  f_)
 	if (!is_a<symbol>(x)) {
 		throw(std::invalid_argument("first argument of integral must be of type symbol"));
 	}
+	integrals_exist = true;
 }
 
 //////////
@@ -76,6 +98,7 @@ integral::integral(const archive_node & n, lst & sym_lst) : inherited(n, sym_lst
 	n.find_ex("a", a, sym_lst);
 	n.find_ex("b", b, sym_lst);
 	n.find_ex("f", f, sym_lst);
+	integrals_exist = true;
 }
 
 void integral::archive(archive_node & n) const
@@ -167,8 +190,23 @@ ex integral::eval(int level) const
 		->setflag(status_flags::dynallocated | status_flags::evaluated);
 }
 
-ex integral::evalf(int level) const
+namespace {
+
+/** Values of integrals computed by evalf_integrals() for the evalf call
+ *  in progress on this thread. */
+thread_local const exmap * integral_values = nullptr;
+thread_local bool in_evalf = false;
+
+} // anonymous namespace
+
+ex integral::evalf(int level, PyObject* parent) const
 {
+	if (integral_values != nullptr) {
+		auto found = integral_values->find(*this);
+		if (found != integral_values->end())
+			return found->second;
+	}
+
 	ex ea;
 	ex eb;
 	ex ef;
@@ -180,15 +218,24 @@ ex integral::evalf(int level) const
 	} else if (level == -max_recursion_level) {
 		throw(runtime_error("max recursion level reached"));
 	} else {
-		ea = a.evalf(level-1);
-		eb = b.evalf(level-1);
-		ef = f.evalf(level-1);
+		ea = a.evalf(level-1, parent);
+		eb = b.evalf(level-1, parent);
+		ef = f.evalf(level-1, parent);
 	}
 
 	// 12.34 is just an arbitrary number used to check whether a number
 	// results after subsituting a number for the integration variable.
 	if (is_exactly_a<numeric>(ea) && is_exactly_a<numeric>(eb) 
 			&& is_exactly_a<numeric>(ef.subs(x==12.34).evalf())) {
+		try {
+			return gauss_kronrod(x, ea, eb, ef, relative_integration_error, parent);
+		} catch (logic_error &) {
+			// the integrand cannot be evaluated in doubles, or the
+			// precision of parent is higher
+		} catch (runtime_error &) {
+			// the maximal integration level is reached, e.g. at a
+			// singularity at a boundary
+		}
 		try {
 			return adaptivesimpson(x, ea, eb, ef);
 		} catch (runtime_error &rte) {}
@@ -203,6 +250,7 @@ ex integral::evalf(int level) const
 }
 
 int integral::max_integration_level = 15;
+unsigned integral::evalf_threads = std::thread::hardware_concurrency();
 ex integral::relative_integration_error = 1e-8;
 
 ex subsvalue(const ex & var, const ex & value, const ex & fun)
@@ -213,6 +261,409 @@ ex subsvalue(const ex & var, const ex & value, const ex & fun)
 	throw logic_error("integrand does not evaluate to numeric");
 }
 
+namespace {
+
+// Nodes and weights of the 15 point Kronrod rule on [-1,1], from the
+// outermost node inwards, and the weights of the embedded 7 point Gauss
+// rule, whose nodes are gk_nodes[1], gk_nodes[3], gk_nodes[5], gk_nodes[7].
+const double gk_nodes[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+const double gk_weights[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+const double gauss_weights[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/** Subinterval [center-half, center+half] of a Gauss-Kronrod integration. */
+struct gk_interval
+{
+	double center, half;
+	double integral;   ///< 15 point Kronrod value
+	double error;      ///< difference to the 7 point Gauss value
+	double absolute;   ///< Kronrod value of the integral of |f|
+	int level;
+};
+
+/** Put the 15 nodes of each interval from first on into nodes. */
+void gk_nodes_of(const std::vector<gk_interval> & intervals, size_t first,
+                 std::vector<double> & nodes)
+{
+	nodes.resize(15*(intervals.size()-first));
+	double * p = nodes.data();
+	for (size_t i=first; i<intervals.size(); ++i) {
+		const double c = intervals[i].center, h = intervals[i].half;
+		for (int j=0; j<7; ++j) {
+			*p++ = c - h*gk_nodes[j];
+			*p++ = c + h*gk_nodes[j];
+		}
+		*p++ = c;
+	}
+}
+
+/** Apply both rules to the values at the nodes, in the order of
+ *  gk_nodes_of(). */
+void gk_apply(gk_interval & iv, const double * v)
+{
+	double kronrod = gk_weights[7]*v[14];
+	double gauss = gauss_weights[3]*v[14];
+	double absolute = gk_weights[7]*std::fabs(v[14]);
+	for (int j=0; j<7; ++j) {
+		const double pair = v[2*j] + v[2*j+1];
+		kronrod += gk_weights[j]*pair;
+		absolute += gk_weights[j]*(std::fabs(v[2*j]) + std::fabs(v[2*j+1]));
+		if (j % 2 == 1)
+			gauss += gauss_weights[j/2]*pair;
+	}
+	const double h = std::fabs(iv.half);
+	iv.integral = kronrod*iv.half;
+	iv.error = std::fabs(kronrod - gauss)*h;
+	iv.absolute = absolute*h;
+	if (!std::isfinite(iv.integral) || !std::isfinite(iv.error))
+		throw invalid_argument("gauss_kronrod(): integrand is not finite at a node");
+}
+
+/** Adaptive Gauss-Kronrod integration from lower to upper.  Intervals are
+ *  bisected while their estimated error exceeds their share of the
+ *  relative error, at most integral::max_integration_level times.  The
+ *  values of the integrand at n nodes are computed by values(n, nodes, out),
+ *  in every step for all new intervals together. */
+template <typename F>
+double gk_integrate(double lower, double upper, double tolerance, F values)
+{
+	const double length = std::fabs(upper - lower);
+	if (length == 0)
+		return 0;
+
+	std::vector<gk_interval> intervals(1);
+	intervals[0].center = (lower + upper)/2;
+	intervals[0].half = (upper - lower)/2;
+	intervals[0].level = 1;
+	std::vector<double> nodes, vals;
+	size_t fresh = 0;
+	while (true) {
+		gk_nodes_of(intervals, fresh, nodes);
+		vals.resize(nodes.size());
+		values(nodes.size(), nodes.data(), vals.data());
+		for (size_t i=fresh; i<intervals.size(); ++i)
+			gk_apply(intervals[i], vals.data() + 15*(i-fresh));
+
+		double total = 0, total_error = 0, total_absolute = 0;
+		for (const auto & iv : intervals) {
+			total += iv.integral;
+			total_error += iv.error;
+			total_absolute += iv.absolute;
+		}
+		const double goal = std::max(tolerance*std::fabs(total),
+		                             50*DBL_EPSILON*total_absolute);
+		if (total_error <= goal)
+			return total;
+
+		// bisect the intervals exceeding their share of the error; the
+		// new halves are appended and evaluated in the next step
+		std::vector<gk_interval> kept;
+		std::vector<gk_interval> halves;
+		for (const auto & iv : intervals) {
+			if (iv.error <= goal*2*std::fabs(iv.half)/length) {
+				kept.push_back(iv);
+				continue;
+			}
+			if (iv.level >= integral::max_integration_level)
+				throw runtime_error("max integration level reached");
+			gk_interval half = iv;
+			half.half = iv.half/2;
+			half.level = iv.level + 1;
+			half.center = iv.center - half.half;
+			halves.push_back(half);
+			half.center = iv.center + half.half;
+			halves.push_back(half);
+		}
+		fresh = kept.size();
+		kept.insert(kept.end(), halves.begin(), halves.end());
+		intervals.swap(kept);
+	}
+}
+
+/** Call work(first, last) on consecutive parts of [0, n), on up to
+ *  threads threads.  An exception thrown by one of the calls is passed
+ *  on after all of them have finished. */
+template <typename F>
+void parallel_for(size_t n, unsigned threads, F work)
+{
+	if (threads > n)
+		threads = n;
+	if (threads < 2) {
+		work(0, n);
+		return;
+	}
+	const size_t per_thread = (n + threads - 1) / threads;
+	std::vector<std::exception_ptr> errors(threads);
+	std::vector<std::thread> pool;
+	for (unsigned t=0; t<threads; ++t) {
+		const size_t first = t * per_thread;
+		const size_t last = std::min(n, first + per_thread);
+		pool.push_back(std::thread([&, t, first, last]() {
+			try {
+				work(first, last);
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		}));
+	}
+	for (auto & th : pool)
+		th.join();
+	for (const auto & e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
+
+/** An integral translated for evaluation in doubles.  The boundaries are
+ *  compiled as functions of the variables of the enclosing integrals, the
+ *  integrand as a function of these, the integration variable and the
+ *  values of the integrals occurring in it, which are translated in turn.
+ *  Evaluation only works on doubles, so it may run on several threads. */
+class quadrature {
+public:
+	/** @exception invalid_argument if a part cannot be compiled to a
+	 *  real function of outer, respectively outer and the integration
+	 *  variable */
+	quadrature(const ex & i, const std::vector<symbol> & outer, double tol);
+
+	/** The value at the values outer[0], ... of the enclosing variables.
+	 *  The inner integrals at the nodes are computed on up to threads
+	 *  threads; the result does not depend on their number. */
+	double operator()(const double * outer, unsigned threads) const;
+
+	bool is_nested() const { return !inner.empty(); }
+
+private:
+	compiled_ex compile_integrand(const ex & i, const std::vector<symbol> & outer);
+	void values(size_t n, const double * outer, const double * nodes, double * out, unsigned threads) const;
+
+	double tolerance;
+	std::vector<quadrature> inner;
+	compiled_ex lower, upper, integrand;
+};
+
+/** Replaces the integrals in an integrand by symbols standing for their
+ *  values, and translates them. */
+class inner_integrals : public map_function {
+public:
+	inner_integrals(const std::vector<symbol> & v, double t, std::vector<quadrature> & q)
+	  : vars(v), tolerance(t), translated(q) { }
+
+	ex operator()(const ex & e) override
+	{
+		if (!is_exactly_a<integral>(e))
+			return e.map(*this);
+		auto found = values.find(e);
+		if (found != values.end())
+			return found->second;
+		translated.push_back(quadrature(e, vars, tolerance));
+		symbols.push_back(symbol());
+		values[e] = symbols.back();
+		return symbols.back();
+	}
+
+	std::vector<symbol> symbols;
+
+private:
+	const std::vector<symbol> & vars;
+	double tolerance;
+	std::vector<quadrature> & translated;
+	exmap values;
+};
+
+quadrature::quadrature(const ex & i, const std::vector<symbol> & outer, double tol)
+  : tolerance(tol), lower(i.op(1), outer), upper(i.op(2), outer),
+    integrand(compile_integrand(i, outer))
+{
+	if (!lower.is_real() || !upper.is_real() || !integrand.is_real())
+		throw invalid_argument("quadrature: integral has complex constants");
+}
+
+compiled_ex quadrature::compile_integrand(const ex & i, const std::vector<symbol> & outer)
+{
+	const symbol & x = ex_to<symbol>(i.op(0));
+	for (const auto & s : outer)
+		if (s.is_equal(x))
+			throw invalid_argument("quadrature: integration variable of an enclosing integral");
+	std::vector<symbol> vars(outer);
+	vars.push_back(x);
+	inner_integrals replace(vars, tolerance, inner);
+	const ex f = replace(i.op(3));
+	vars.insert(vars.end(), replace.symbols.begin(), replace.symbols.end());
+	return compiled_ex(f, vars);
+}
+
+double quadrature::operator()(const double * outer, unsigned threads) const
+{
+	std::vector<const double *> args(lower.nargs());
+	for (size_t v=0; v<args.size(); ++v)
+		args[v] = outer + v;
+	double a, b;
+	lower.evaluate(1, args.data(), &a);
+	upper.evaluate(1, args.data(), &b);
+	if (!std::isfinite(a) || !std::isfinite(b))
+		throw invalid_argument("quadrature: boundaries are not finite");
+	return gk_integrate(a, b, tolerance,
+		[&](size_t n, const double * nodes, double * out) {
+			values(n, outer, nodes, out, threads);
+		});
+}
+
+void quadrature::values(size_t n, const double * outer, const double * nodes, double * out, unsigned threads) const
+{
+	// one column of n values per argument of the integrand: the
+	// enclosing variables, the nodes, then the inner integrals
+	const size_t nouter = lower.nargs();
+	std::vector<double> columns((nouter + inner.size()) * n);
+	for (size_t v=0; v<nouter; ++v)
+		std::fill_n(columns.begin() + v*n, n, outer[v]);
+	parallel_for(inner.empty() ? 0 : n, threads, [&](size_t first, size_t last) {
+		std::vector<double> point(outer, outer + nouter);
+		point.push_back(0);
+		for (size_t j=first; j<last; ++j) {
+			point[nouter] = nodes[j];
+			for (size_t k=0; k<inner.size(); ++k)
+				columns[(nouter + k)*n + j] = inner[k](point.data(), 1);
+		}
+	});
+
+	std::vector<const double *> args;
+	for (size_t v=0; v<nouter; ++v)
+		args.push_back(columns.data() + v*n);
+	args.push_back(nodes);
+	for (size_t k=0; k<inner.size(); ++k)
+		args.push_back(columns.data() + (nouter + k)*n);
+	integrand.evaluate(n, args.data(), out);
+}
+
+/** Put the outermost integrals in e into found.  Every node is visited
+ *  once, also if it is shared. */
+void collect_integrals(const ex & e, exvector & found,
+                       std::unordered_set<const basic *> & seen)
+{
+	if (e.nops() == 0 || !seen.insert(&ex_to<basic>(e)).second)
+		return;
+	if (is_exactly_a<integral>(e)) {
+		found.push_back(e);
+		return;
+	}
+	for (size_t i=0; i<e.nops(); ++i)
+		collect_integrals(e.op(i), found, seen);
+}
+
+} // anonymous namespace
+
+/** Evaluate e numerically.  Called by ex::evalf().  At the outermost call,
+ *  the integrals in e which can be computed in doubles are computed first,
+ *  on integral::evalf_threads threads: several integrals are computed at
+ *  the same time, a single nested integral is split over the nodes of the
+ *  outer quadrature.  The values are the same for any number of threads.
+ *  The other integrals, and all of them if parent has more than double
+ *  precision, are left to integral::evalf(). */
+ex evalf_integrals(const ex & e, int level, PyObject* parent)
+{
+	if (in_evalf)
+		return ex_to<basic>(e).evalf(level, parent);
+	struct reset_guard {
+		~reset_guard() { in_evalf = false; integral_values = nullptr; }
+	} guard;
+	in_evalf = true;
+	if (!integrals_exist || !is_machine_precision(parent))
+		return ex_to<basic>(e).evalf(level, parent);
+
+	exvector found;
+	std::unordered_set<const basic *> seen;
+	collect_integrals(e, found, seen);
+	if (found.empty())
+		return ex_to<basic>(e).evalf(level, parent);
+	std::sort(found.begin(), found.end(), ex_is_less());
+	found.erase(std::unique(found.begin(), found.end(), ex_is_equal()), found.end());
+
+	// translate them here, running evaluation on the other threads only
+	// touches doubles
+	const double tolerance = std::fabs(ex_to<numeric>(integral::relative_integration_error).to_double());
+	std::vector<quadrature> translated;
+	exvector translated_from;
+	bool nested = false;
+	for (const auto & i : found) {
+		try {
+			translated.push_back(quadrature(i, std::vector<symbol>(), tolerance));
+			translated_from.push_back(i);
+			nested = nested || translated.back().is_nested();
+		} catch (logic_error &) {}
+	}
+
+	const unsigned threads = std::max(integral::evalf_threads, 1u);
+	std::vector<double> results(translated.size());
+	std::vector<char> computed(translated.size(), 0);
+	auto compute = [&](size_t i, unsigned node_threads) {
+		try {
+			results[i] = translated[i](nullptr, node_threads);
+			computed[i] = 1;
+		} catch (std::exception &) {}
+	};
+	if (translated.size() >= threads || !nested)
+		parallel_for(translated.size(), threads, [&](size_t first, size_t last) {
+			for (size_t i=first; i<last; ++i)
+				compute(i, 1);
+		});
+	else
+		for (size_t i=0; i<translated.size(); ++i)
+			compute(i, threads);
+
+	exmap values;
+	for (size_t i=0; i<translated.size(); ++i)
+		if (computed[i])
+			values[translated_from[i]] = numeric(results[i]).evalf(0, parent);
+	integral_values = &values;
+	return ex_to<basic>(e).evalf(level, parent);
+}
+
+/** Numeric integration by the adaptive 15 point Gauss-Kronrod rule, in
+ *  double precision.  The integrand is compiled once, and in every step
+ *  the nodes of all intervals which are bisected are evaluated together.
+ *  Intervals are bisected while the estimated error exceeds their share
+ *  of the relative error, at most integral::max_integration_level times.
+ *  The integrand is never evaluated at the boundaries.  Integrals in the
+ *  integrand are computed in the same way.
+ *
+ *  @param parent  Python parent of the result, or nullptr for the default
+ *  @exception invalid_argument if the integrand cannot be compiled to a
+ *  real function of x, is not finite at a node, or if the error is too
+ *  small or the precision of parent too high for double precision
+ *  @exception runtime_error if the boundaries or the error are not numbers,
+ *  or the maximal integration level is reached */
+ex gauss_kronrod(const ex & x, const ex & a_in, const ex & b_in, const ex & f, const ex & error, PyObject* parent)
+{
+	if (!is_machine_precision(parent))
+		throw invalid_argument("gauss_kronrod(): precision of parent above double precision");
+	ex a = is_exactly_a<numeric>(a_in) ? a_in : a_in.evalf(0, parent);
+	ex b = is_exactly_a<numeric>(b_in) ? b_in : b_in.evalf(0, parent);
+	if (!is_exactly_a<numeric>(a) || !is_exactly_a<numeric>(b))
+		throw std::runtime_error("For numerical integration the boundaries of the integral should evalf into numbers.");
+	if (!is_exactly_a<numeric>(error))
+		throw std::runtime_error("For numerical integration the error should be a number.");
+	if (!ex_to<numeric>(a).is_real() || !ex_to<numeric>(b).is_real())
+		throw invalid_argument("gauss_kronrod(): boundaries are not real");
+	const double tolerance = std::fabs(ex_to<numeric>(error).to_double());
+	if (tolerance < 50*DBL_EPSILON)
+		throw invalid_argument("gauss_kronrod(): error below double precision");
+
+	const quadrature q(integral(x, a, b, f), std::vector<symbol>(), tolerance);
+	return numeric(q(nullptr, 1)).evalf(0, parent);
+}
+
 struct error_and_integral
 {
 	error_and_integral(ex err, ex integ)
@@ -236,6 +687,56 @@ struct error_and_integral_is_less
 
 typedef map<error_and_integral, ex, error_and_integral_is_less> lookup_map;
 
+/** Results of adaptivesimpson(), removed oldest first when the
+ *  cache_manager asks for memory. */
+class integral_cache : public managed_cache
+{
+public:
+	integral_cache() : managed_cache("numerical integrals") {}
+
+	bool lookup(const error_and_integral & key, ex & result) const
+	{
+		auto it = entries.find(key);
+		if (it == entries.end())
+			return false;
+		result = it->second;
+		return true;
+	}
+
+	void insert(const error_and_integral & key, const ex & result)
+	{
+		auto ins = entries.insert(std::make_pair(key, result));
+		if (!ins.second)
+			return;
+		order.push_back(ins.first);
+		account(entry_size);
+	}
+
+	void evict(size_t amount) override
+	{
+		size_t freed = 0;
+		while (freed < amount && !order.empty()) {
+			entries.erase(order.front());
+			order.pop_front();
+			freed += entry_size;
+		}
+		account(-static_cast<std::ptrdiff_t>(freed));
+	}
+
+	void flush() override
+	{
+		evict(order.size() * entry_size);
+	}
+
+protected:
+	// map node, list node, and the integral object in the key
+	static const size_t entry_size = sizeof(lookup_map::value_type)
+	                                 + sizeof(integral) + 7*sizeof(void *);
+
+	lookup_map entries;
+	std::list<lookup_map::iterator> order;
+};
+
 /** Numeric integration routine based upon the "Adaptive Quadrature" one
   * in "Numerical Analysis" by Burden and Faires. Parameters are integration
   * variable, left boundary, right boundary, function to be integrated and
@@ -254,12 +755,12 @@ ex adaptivesimpson(const ex & x, const ex & a_in, const ex & b_in, const ex & f,
 		throw std::runtime_error("For numerical integration the error should be a number.");
 
 	// Use lookup table to be potentially much faster.
-	static lookup_map lookup;
+	static integral_cache lookup;
 	static symbol ivar("ivar");
 	ex lookupex = integral(ivar,a,b,f.subs(x==ivar));
-	auto emi = lookup.find(error_and_integral(error, lookupex));
-	if (emi!=lookup.end())
-		return emi->second;
+	ex cached;
+	if (lookup.lookup(error_and_integral(error, lookupex), cached))
+		return cached;
 
 	ex app = 0;
 	int i = 1;
@@ -322,7 +823,7 @@ ex adaptivesimpson(const ex & x, const ex & a_in, const ex & b_in, const ex & f,
 		}
 	}
 
-	lookup[error_and_integral(error, lookupex)]=app;
+	lookup.insert(error_and_integral(error, lookupex), app);
 	return app;
 }
 
@@ -41,7 +41,7 @@ public:
 public:
 	unsigned precedence() const override {return 45;}
 	ex eval(int level=0) const override;
-	ex evalf(int level=0) const;
+	ex evalf(int level=0, PyObject* parent=nullptr) const override;
 	int degree(const ex & s) const override;
 	int ldegree(const ex & s) const override;
 	ex eval_ncmul(const exvector & v) const override;
@@ -67,6 +67,7 @@ protected:
 	void do_print_latex(const print_latex & c, unsigned level) const;
 public:
 	static int max_integration_level;
+	static unsigned evalf_threads;  ///< used by evalf_integrals()
 	static ex relative_integration_error;
 private:
 	ex x;
@@ -77,6 +78,17 @@ private:
 
 // utility functions
 
+GiNaC::ex evalf_integrals(const GiNaC::ex &e, int level, PyObject* parent);
+
+GiNaC::ex gauss_kronrod(
+	const GiNaC::ex &x,
+	const GiNaC::ex &a,
+	const GiNaC::ex &b,
+	const GiNaC::ex &f,
+	const GiNaC::ex &error = integral::relative_integration_error,
+	PyObject* parent = nullptr
+);
+
 GiNaC::ex adaptivesimpson(
 	const GiNaC::ex &x,
 	const GiNaC::ex &a,
@@ -21,6 +21,8 @@
  */
 
 #include "matrix.h"
+#include "dag.h"
+#include "float_matrix.h"
 #include "numeric.h"
 #include "lst.h"
 #include "idx.h"
@@ -586,26 +588,75 @@ matrix matrix::sub(const matrix & other) const
 }
 
 
-/** Product of matrices.
+/** Number of rows of the left factor that matrix::mul() handles as one
+ *  block. */
+static const unsigned mul_block_rows = 16;
+
+/** Product of matrices.  Every entry of the result is assembled as one
+ *  sum of its non-vanishing products instead of being accumulated by
+ *  repeated additions, which would rebuild the partial sum each time.  The
+ *  rows of *this are traversed in blocks of mul_block_rows rows, so that the
+ *  columns of other which are touched by a block stay hot in the cache.
  *
  *  @exception logic_error (incompatible matrices) */
 matrix matrix::mul(const matrix & other) const
 {
 	if (this->cols() != other.rows())
 		throw std::logic_error("matrix::mul(): incompatible matrices");
+
+	// Matrices of floats are multiplied in machine arithmetic
+	matrix fprod;
+	if (float_matrix_mul(*this, other, fprod))
+		return fprod;
 	
-	exvector prod(this->rows()*other.cols());
-	
-	for (unsigned r1=0; r1<this->rows(); ++r1) {
-		for (unsigned c=0; c<this->cols(); ++c) {
-			// Quick test: can we shortcut?
-			if (m[r1*col+c].is_zero())
+	const unsigned n = other.col;
+	exvector prod(row*n);
+
+	// Quick test: can we shortcut?  Record the positions of the non-zero
+	// elements once, so the inner loops never look at a zero again.
+	std::vector<std::vector<unsigned>> row_nz(row), col_nz(n);
+	for (unsigned r=0; r<row; ++r)
+		for (unsigned c=0; c<col; ++c)
+			if (!m[r*col+c].is_zero())
+				row_nz[r].push_back(c);
+	for (unsigned c=0; c<other.row; ++c)
+		for (unsigned r2=0; r2<n; ++r2)
+			if (!other.m[c*n+r2].is_zero())
+				col_nz[r2].push_back(c);
+
+	exvector terms;
+	terms.reserve(col);
+	for (unsigned rb=0; rb<row; rb+=mul_block_rows) {
+		const unsigned rend = std::min(row, rb+mul_block_rows);
+		for (unsigned r2=0; r2<n; ++r2) {
+			const std::vector<unsigned> & cnz = col_nz[r2];
+			if (cnz.empty())
 				continue;
-			for (unsigned r2=0; r2<other.cols(); ++r2)
-				prod[r1*other.col+r2] += (m[r1*col+c] * other.m[c*other.col+r2]);
+			for (unsigned r1=rb; r1<rend; ++r1) {
+				// merge the two sorted index lists
+				const std::vector<unsigned> & rnz = row_nz[r1];
+				auto ri = rnz.begin(), rend_it = rnz.end();
+				auto ci = cnz.begin(), cend_it = cnz.end();
+				terms.clear();
+				while (ri != rend_it && ci != cend_it) {
+					if (*ri < *ci)
+						++ri;
+					else if (*ci < *ri)
+						++ci;
+					else {
+						terms.push_back(m[r1*col+*ri] * other.m[*ri*n+r2]);
+						++ri;
+						++ci;
+					}
+				}
+				if (terms.size() == 1)
+					prod[r1*n+r2] = terms[0];
+				else if (!terms.empty())
+					prod[r1*n+r2] = (new GiNaC::add(terms))->setflag(status_flags::dynallocated);
+			}
 		}
 	}
-	return matrix(row, other.col, prod);
+	return matrix(row, n, prod);
 }
 
 
@@ -666,14 +717,23 @@ matrix matrix::pow(const ex & expn) const
 			// that this is not entirely optimal but close to optimal and
 			// "better" algorithms are much harder to implement.  (See Knuth,
 			// TAoCP2, section "Evaluation of Powers" for a good discussion.)
+			// As long as C is still the unit matrix it is not multiplied but
+			// simply replaced.
+			bool C_is_unit = true;
 			while (b!=*_num1_p) {
 				if (b.is_odd()) {
-					C = C.mul(A);
+					if (C_is_unit)
+						C = A;
+					else
+						C = C.mul(A);
+					C_is_unit = false;
 					--b;
 				}
 				b /= *_num2_p;  // still integer.
 				A = A.mul(A);
 			}
+			if (C_is_unit)
+				return A;
 			return A.mul(C);
 		}
 	}
@@ -742,6 +802,12 @@ ex matrix::determinant(unsigned algo) const
 	if (row!=col)
 		throw (std::logic_error("matrix::determinant(): matrix not square"));
 	GINAC_ASSERT(row*col==m.capacity());
+
+	// Matrices of floats are decomposed in machine arithmetic
+	ex fdet;
+	if ((algo == determinant_algo::automatic || algo == determinant_algo::gauss)
+	    && float_matrix_determinant(*this, fdet))
+		return fdet;
 	
 	// Gather some statistical information about this matrix:
 	bool numeric_flag = true;
@@ -954,6 +1020,11 @@ matrix matrix::inverse() const
 	matrix identity(row,col);
 	for (unsigned i=0; i<row; ++i)
 		identity(i,i) = _ex1;
+
+	// Matrices of floats are inverted in machine arithmetic
+	matrix fsol;
+	if (float_matrix_solve(*this, identity, fsol))
+		return fsol;
 	
 	// Populate a dummy matrix of variables, just because of compatibility with
 	// matrix::solve() which wants this (for compatibility with under-determined
@@ -1002,6 +1073,12 @@ matrix matrix::solve(const matrix & vars,
 		for (unsigned co=0; co<p; ++co)
 			if (!vars(ro,co).info(info_flags::symbol))
 				throw (std::invalid_argument("matrix::solve(): 1st argument must be matrix of symbols"));
+
+	// Regular systems of floats are solved in machine arithmetic
+	matrix fsol;
+	if ((algo == solve_algo::automatic || algo == solve_algo::gauss)
+	    && float_matrix_solve(*this, rhs, fsol))
+		return fsol;
 	
 	// build the augmented matrix of *this with rhs attached to the right
 	matrix aug(mm,n+p);
@@ -1081,6 +1158,19 @@ matrix matrix::solve(const matrix & vars,
 }
 
 
+/** Factor this matrix for repeated solving of linear systems.
+ *
+ *  @param algo selects the factorization, see lu_decomposition
+ *  @return the factorization object
+ *  @exception logic_error (matrix not square)
+ *  @exception runtime_error (singular matrix)
+ *  @see lu_decomposition */
+lu_decomposition matrix::lu_decompose(unsigned algo) const
+{
+	return lu_decomposition(*this, algo);
+}
+
+
 /** Compute the rank of this matrix. */
 unsigned matrix::rank() const
 {
@@ -1531,6 +1621,226 @@ int matrix::pivot(unsigned ro, unsigned co, bool symbolic)
 	return k;
 }
 
+//////////
+// LU decomposition
+//////////
+
+/** Construct the LU factorization of a square matrix.  As in
+ *  matrix::pivot(), the element of largest absolute value is chosen as
+ *  pivot if the rest of the column is numeric, otherwise the first
+ *  non-zero element.  The automatic choice of
+ *  algorithm follows matrix::solve(): purely numeric matrices use Gauss
+ *  elimination, all others the fraction-free scheme.  solve_algo::divfree
+ *  has no factored form and is mapped to solve_algo::bareiss.
+ *
+ *  @exception logic_error (matrix not square)
+ *  @exception runtime_error (singular matrix) */
+lu_decomposition::lu_decomposition(const matrix & A, unsigned algo_)
+  : n(A.rows()), algo(algo_), sign(1), lu(A.rows()*A.cols()), perm(A.rows())
+{
+	if (A.rows() != A.cols())
+		throw (std::logic_error("matrix::lu_decompose(): matrix not square"));
+
+	bool numeric_flag = true;
+	for (unsigned r=0; r<n; ++r) {
+		perm[r] = r;
+		for (unsigned c=0; c<n; ++c) {
+			const ex & e = A(r,c);
+			if (!e.info(info_flags::numeric))
+				numeric_flag = false;
+			lu[r*n+c] = e.normal();
+		}
+	}
+	if (algo == solve_algo::automatic)
+		algo = numeric_flag ? solve_algo::gauss : solve_algo::bareiss;
+	else if (algo != solve_algo::gauss)
+		algo = solve_algo::bareiss;
+
+	ex oldpivot = _ex1;
+	for (unsigned k=0; k<n; ++k) {
+		bool numeric_column = true;
+		for (unsigned i=k; i<n && numeric_column; ++i)
+			numeric_column = is_exactly_a<numeric>(lu[i*n+k]);
+		unsigned p = k;
+		if (numeric_column) {
+			numeric pmax = abs(ex_to<numeric>(lu[k*n+k]));
+			for (unsigned i=k+1; i<n; ++i) {
+				const numeric a = abs(ex_to<numeric>(lu[i*n+k]));
+				if (a > pmax) {
+					pmax = a;
+					p = i;
+				}
+			}
+			if (pmax.is_zero())
+				p = n;
+		} else {
+			while (p<n && lu[p*n+k].is_zero())
+				++p;
+		}
+		if (p == n)
+			throw (std::runtime_error("matrix::lu_decompose(): singular matrix"));
+		if (p != k) {
+			for (unsigned c=0; c<n; ++c)
+				lu[p*n+c].swap(lu[k*n+c]);
+			std::swap(perm[p], perm[k]);
+			sign = -sign;
+		}
+		const ex & piv = lu[k*n+k];
+		for (unsigned i=k+1; i<n; ++i) {
+			if (algo == solve_algo::gauss) {
+				ex l = (lu[i*n+k] / piv).normal();
+				lu[i*n+k] = l;
+				if (l.is_zero())
+					continue;
+				for (unsigned j=k+1; j<n; ++j)
+					lu[i*n+j] = (lu[i*n+j] - l*lu[k*n+j]).normal();
+			} else {
+				// Bareiss step, the division by the previous pivot is exact
+				// and L keeps the column as it stands before the step.
+				const ex & l = lu[i*n+k];
+				for (unsigned j=k+1; j<n; ++j)
+					lu[i*n+j] = ((piv*lu[i*n+j] - l*lu[k*n+j]) / oldpivot).normal();
+			}
+		}
+		oldpivot = piv;
+	}
+}
+
+
+/** Solve P*A*x == P*b for one right hand side, overwriting the column b
+ *  with the solution x. */
+void lu_decomposition::solve_column(exvector & x) const
+{
+	GINAC_ASSERT(x.size() == n);
+	exvector b(n);
+	for (unsigned i=0; i<n; ++i)
+		b[i] = x[perm[i]];
+
+	// forward substitution with L
+	for (unsigned i=0; i<n; ++i) {
+		exvector terms;
+		terms.reserve(i+1);
+		if (!b[i].is_zero())
+			terms.push_back(b[i]);
+		for (unsigned j=0; j<i; ++j)
+			if (!lu[i*n+j].is_zero() && !b[j].is_zero())
+				terms.push_back(-lu[i*n+j]*b[j]);
+		ex s = (new add(terms))->setflag(status_flags::dynallocated);
+		if (algo == solve_algo::gauss)
+			b[i] = s.normal();
+		else
+			b[i] = (s / lu[i*n+i]).normal();
+	}
+
+	// in the fraction-free case L*D^(-1)*U*x == P*b, so scale by D
+	if (algo == solve_algo::bareiss) {
+		for (unsigned i=0; i<n; ++i) {
+			ex d = lu[i*n+i];
+			if (i > 0)
+				d *= lu[(i-1)*n+i-1];
+			b[i] = (b[i]*d).normal();
+		}
+	}
+
+	// back substitution with U
+	for (int i=n-1; i>=0; --i) {
+		exvector terms;
+		terms.reserve(n-i);
+		if (!b[i].is_zero())
+			terms.push_back(b[i]);
+		for (unsigned j=i+1; j<n; ++j)
+			if (!lu[i*n+j].is_zero() && !x[j].is_zero())
+				terms.push_back(-lu[i*n+j]*x[j]);
+		ex s = (new add(terms))->setflag(status_flags::dynallocated);
+		x[i] = (s / lu[i*n+i]).normal();
+	}
+}
+
+
+/** Solve A*x == rhs for an n x p right hand side.  The p columns are
+ *  independent systems that share the factorization.
+ *
+ *  @exception logic_error (incompatible matrices) */
+matrix lu_decomposition::solve(const matrix & rhs) const
+{
+	if (rhs.rows() != n)
+		throw (std::logic_error("lu_decomposition::solve(): incompatible matrices"));
+
+	const unsigned p = rhs.cols();
+	matrix sol(n, p);
+	exvector x(n);
+	for (unsigned co=0; co<p; ++co) {
+		for (unsigned r=0; r<n; ++r)
+			x[r] = rhs(r,co);
+		solve_column(x);
+		for (unsigned r=0; r<n; ++r)
+			sol(r,co) = x[r];
+	}
+	return sol;
+}
+
+
+/** Solve A*x == b for a batch of right hand sides.
+ *
+ *  @exception logic_error (incompatible matrices) */
+std::vector<matrix> lu_decomposition::solve(const std::vector<matrix> & rhs) const
+{
+	std::vector<matrix> sols;
+	sols.reserve(rhs.size());
+	for (const auto & b : rhs)
+		sols.push_back(solve(b));
+	return sols;
+}
+
+
+/** Determinant of the factored matrix, normalized. */
+ex lu_decomposition::determinant() const
+{
+	if (n == 0)
+		return _ex1;
+	if (algo == solve_algo::bareiss)
+		return (sign*lu[n*n-1]).normal();
+	ex det = sign;
+	for (unsigned k=0; k<n; ++k)
+		det *= lu[k*n+k];
+	return det.normal();
+}
+
+
+/** Inverse of the factored matrix. */
+matrix lu_decomposition::inverse() const
+{
+	matrix identity(n,n);
+	for (unsigned i=0; i<n; ++i)
+		identity(i,i) = _ex1;
+	return solve(identity);
+}
+
+
+/** The lower triangular factor L. */
+matrix lu_decomposition::lower() const
+{
+	matrix L(n,n);
+	for (unsigned r=0; r<n; ++r) {
+		for (unsigned c=0; c<r; ++c)
+			L(r,c) = lu[r*n+c];
+		L(r,r) = (algo == solve_algo::gauss) ? _ex1 : lu[r*n+r];
+	}
+	return L;
+}
+
+
+/** The upper triangular factor U. */
+matrix lu_decomposition::upper() const
+{
+	matrix U(n,n);
+	for (unsigned r=0; r<n; ++r)
+		for (unsigned c=r; c<n; ++c)
+			U(r,c) = lu[r*n+c];
+	return U;
+}
+
+
 /** Function to check that all elements of the matrix are zero.
  */
 bool matrix::is_zero_matrix() const
@@ -1679,4 +1989,58 @@ ex sub_matrix(const matrix&m, unsigned r, unsigned nr, unsigned c, unsigned nc)
 	return M;
 }
 
+/** Differentiate the elements of exprs with respect to each symbol in vars,
+ *  visiting each distinct subexpression once per symbol.  Derivatives of
+ *  subexpressions shared between the expressions are shared between the
+ *  entries of the result.
+ *
+ *  @exception invalid_argument if vars contains something else than symbols */
+ex jacobian(const lst & exprs, const lst & vars)
+{
+	matrix &M = *new matrix(exprs.nops(), vars.nops());
+	M.setflag(status_flags::dynallocated);
+
+	unsigned c = 0;
+	for (const auto & v : vars) {
+		if (!is_exactly_a<symbol>(v))
+			throw std::invalid_argument("jacobian(): variables must be symbols");
+		dag_derivative D(ex_to<symbol>(v));
+		unsigned r = 0;
+		for (const auto & e : exprs)
+			M(r++, c) = D(e);
+		++c;
+	}
+
+	return M;
+}
+
+/** Differentiate e twice with respect to the symbols in vars.  The first
+ *  derivatives are differentiated by one dag_derivative per symbol, so
+ *  the work on subexpressions common to them is done once, and each mixed
+ *  derivative is computed only once for both entries.
+ *
+ *  @exception invalid_argument if vars contains something else than symbols */
+ex hessian(const ex & e, const lst & vars)
+{
+	const size_t n = vars.nops();
+	std::vector<dag_derivative> D;
+	D.reserve(n);
+	for (const auto & v : vars) {
+		if (!is_exactly_a<symbol>(v))
+			throw std::invalid_argument("hessian(): variables must be symbols");
+		D.push_back(dag_derivative(ex_to<symbol>(v)));
+	}
+
+	matrix &M = *new matrix(n, n);
+	M.setflag(status_flags::dynallocated);
+
+	for (unsigned i=0; i<n; ++i) {
+		const ex gradi = D[i](e);
+		for (unsigned j=0; j<=i; ++j)
+			M(i, j) = M(j, i) = D[j](gradi);
+	}
+
+	return M;
+}
+
 } // namespace GiNaC
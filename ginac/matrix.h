@@ -31,6 +31,8 @@
 
 namespace GiNaC {
 
+class lu_decomposition;
+
 
 /** Helper template to allow initialization of matrices via an overloaded
  *  comma operator (idea stolen from Blitz++). */
@@ -151,6 +153,7 @@ public:
 	matrix inverse() const;
 	matrix solve(const matrix & vars, const matrix & rhs,
 	             unsigned algo = solve_algo::automatic) const;
+	lu_decomposition lu_decompose(unsigned algo = solve_algo::automatic) const;
 	unsigned rank() const;
 	bool is_zero_matrix() const;
 protected:
@@ -173,6 +176,47 @@ protected:
 };
 
 
+/** LU factorization of a square, regular matrix.  The factorization is
+ *  computed once by matrix::lu_decompose() and can then be applied to any
+ *  number of right hand sides, which is much cheaper than calling
+ *  matrix::solve() for each of them.  All entries of the factors are
+ *  normalized when the factorization is set up.
+ *
+ *  With solve_algo::gauss the factorization is P*A == L*U with a unit lower
+ *  triangular L.  With solve_algo::bareiss it is the fraction-free form
+ *  P*A == L*D^(-1)*U where L and U share their diagonal and the entries of
+ *  L and U stay in the integral domain of the entries of A. */
+class lu_decomposition
+{
+public:
+	lu_decomposition(const matrix & A, unsigned algo = solve_algo::automatic);
+
+	unsigned size() const        /// Get dimension of the factored matrix.
+		{ return n; }
+	unsigned algorithm() const   /// Get the solve_algo that was used.
+		{ return algo; }
+	matrix solve(const matrix & rhs) const;
+	std::vector<matrix> solve(const std::vector<matrix> & rhs) const;
+	ex determinant() const;
+	matrix inverse() const;
+	matrix lower() const;
+	matrix upper() const;
+	std::vector<unsigned> permutation() const
+		{ return perm; }
+
+protected:
+	void solve_column(exvector & x) const;
+
+// member variables
+protected:
+	unsigned n;                  ///< dimension
+	unsigned algo;               ///< solve_algo::gauss or solve_algo::bareiss
+	int sign;                    ///< sign of the row permutation
+	exvector lu;                 ///< L below and U on and above the diagonal
+	std::vector<unsigned> perm;  ///< row i of P*A is row perm[i] of A
+};
+
+
 // wrapper functions around member functions
 
 inline size_t nops(const matrix & m)
@@ -238,6 +282,14 @@ extern ex reduced_matrix(const matrix& m, unsigned r, unsigned c);
 /** Return the nr times nc submatrix starting at position r, c of matrix m. */
 extern ex sub_matrix(const matrix&m, unsigned r, unsigned nr, unsigned c, unsigned nc);
 
+/** Return the matrix of the derivatives of the expressions in exprs with
+ *  respect to the symbols in vars. */
+extern ex jacobian(const lst & exprs, const lst & vars);
+
+/** Return the matrix of the second derivatives of e with respect to the
+ *  symbols in vars. */
+extern ex hessian(const ex & e, const lst & vars);
+
 /** Create an r times c matrix of newly generated symbols consisting of the
  *  given base name plus the numeric row/column position of each element. */
 inline ex symbolic_matrix(unsigned r, unsigned c, const std::string & base_name)
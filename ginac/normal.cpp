@@ -1999,6 +1999,7 @@ struct normal_map_function : public map_function {
 	int level;
 	normal_map_function(int l) : level(l) {}
 	ex operator()(const ex & e) override { return normal(e, level); }
+	bool is_pure() const override { return true; }
 };
 
 /** Default implementation of ex::normal(). It normalizes the children and
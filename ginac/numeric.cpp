@@ -57,6 +57,9 @@
 #include "tostring.h"
 #include "utils.h"
 
+#include <cmath>
+#include <limits>
+
 //#define Logging_refctr
 #if defined(Logging_refctr)
 #undef Py_INCREF
@@ -83,6 +86,18 @@ const GiNaC::numeric& to_numeric(GiNaC::ex& e)
         return GiNaC::ex_to<GiNaC::numeric>(e);
 }
 
+// If *this is a machine double in the domain cond, evaluate expr on its
+// value x with the C library and return it, unless the result overflowed
+// or is undefined.  Everything else falls through to the Python function.
+#define DOUBLE_RETURN(cond, expr)  {				 \
+    double x;							 \
+    if (get_machine_double(x) && (cond)) {			 \
+      const double r = (expr);					 \
+      if (std::isfinite(r))					 \
+        return numeric(r);					 \
+    }								 \
+  }
+
 // Call the Python function f on *this as input and return the result
 // as a PyObject*.
 #define PY_RETURN(f)  PyObject *a = to_pyobject();		 \
@@ -741,9 +756,47 @@ void numeric::do_print_latex(const print_latex & c, unsigned level) const {
         print_numeric(c, "{(", ")}", "i", " ", level, true);
 }
 
+/** Print a real number as a C floating point literal.  Integers are
+ *  printed exactly as long as a double can hold them, rationals as
+ *  quotients of such integers. */
+static void print_real_csrc(const print_csrc & c, const numeric & x)
+{
+        if (x.is_integer() and std::fabs(x.to_double()) < 9007199254740992.0)
+                c.s << x.to_long() << ".0";
+        else if (x.is_rational() and not x.is_integer()) {
+                if (x.is_negative())
+                        c.s << '-';
+                c.s << '(';
+                print_real_csrc(c, x.numer().abs());
+                c.s << '/';
+                print_real_csrc(c, x.denom());
+                c.s << ')';
+        } else
+                c.s << x.to_double();
+}
+
 void numeric::do_print_csrc(const print_csrc & c, unsigned) const {
-        // TODO: not really needed?
-        stub("print_csrc");
+        std::ios::fmtflags oldflags = c.s.flags();
+        std::streamsize oldprec = c.s.precision();
+        c.s.setf(std::ios::scientific, std::ios::floatfield);
+        if (is_a<print_csrc_float>(c))
+                c.s.precision(std::numeric_limits<float>::max_digits10);
+        else
+                c.s.precision(std::numeric_limits<double>::max_digits10);
+
+        if (is_real())
+                print_real_csrc(c, *this);
+        else {
+                c.s << (is_a<print_csrc_float>(c) ? "std::complex<float>("
+                                                 : "std::complex<double>(");
+                print_real_csrc(c, real());
+                c.s << ',';
+                print_real_csrc(c, imag());
+                c.s << ')';
+        }
+
+        c.s.flags(oldflags);
+        c.s.precision(oldprec);
 }
 
 void numeric::do_print_tree(const print_tree & c, unsigned level) const {
@@ -1911,6 +1964,48 @@ double numeric::to_double() const {
         }
 }
 
+/** Check whether the number is a native double or a Python float, i.e.
+ *  has machine precision, and if so store its value in d.  Elementary
+ *  functions of such numbers are computed with the C library instead of
+ *  calling Python. */
+bool numeric::get_machine_double(double & d) const {
+        if (t == DOUBLE) {
+                d = v._double;
+                return true;
+        }
+        if (t == PYOBJECT && PyFloat_CheckExact(v._pyobject)) {
+                d = PyFloat_AS_DOUBLE(v._pyobject);
+                return true;
+        }
+        return false;
+}
+
+/** Check whether evalf() into parent asks for at most the 53 bits of a
+ *  double, so that values computed in machine arithmetic are exact
+ *  enough.  The parent is either a Python parent or the keyword dict
+ *  passed on by function::evalf(), whose entry "parent" is used then.
+ *  No parent means machine precision. */
+bool is_machine_precision(PyObject* parent) {
+        if (parent and PyDict_CheckExact(parent))
+                parent = PyDict_GetItemString(parent, const_cast<char*>("parent"));
+        if (parent == nullptr or parent == Py_None
+            or parent == (PyObject*)&PyFloat_Type
+            or parent == (PyObject*)&PyComplex_Type)
+                return true;
+        PyObject* prec = PyObject_CallMethod(parent, const_cast<char*>("prec"), nullptr);
+        if (prec == nullptr) {
+                PyErr_Clear();
+                return false;
+        }
+        long bits = PyInt_AsLong(prec);
+        Py_DECREF(prec);
+        if (bits == -1 and PyErr_Occurred()) {
+                PyErr_Clear();
+                return false;
+        }
+        return bits <= 53;
+}
+
 /** Real part of a number. */
 const numeric numeric::real() const {
         verbose("real_part(a)");
@@ -2011,10 +2106,12 @@ const numeric numeric::fibonacci() const {
 }
 
 const numeric numeric::sin() const {
+        DOUBLE_RETURN(true, std::sin(x));
         PY_RETURN(py_funcs.py_sin);
 }
 
 const numeric numeric::cos() const {
+        DOUBLE_RETURN(true, std::cos(x));
         PY_RETURN(py_funcs.py_cos);
 }
 
@@ -2027,54 +2124,70 @@ const numeric numeric::stieltjes() const {
 }
 
 const numeric numeric::exp() const {
+        DOUBLE_RETURN(true, std::exp(x));
         PY_RETURN(py_funcs.py_exp);
 }
 
 const numeric numeric::log() const {
+        DOUBLE_RETURN(x > 0, std::log(x));
         PY_RETURN(py_funcs.py_log);
 }
 
 const numeric numeric::tan() const {
+        DOUBLE_RETURN(true, std::tan(x));
         PY_RETURN(py_funcs.py_tan);
 }
 
 const numeric numeric::asin() const {
+        DOUBLE_RETURN(std::fabs(x) <= 1, std::asin(x));
         PY_RETURN(py_funcs.py_asin);
 }
 
 const numeric numeric::acos() const {
+        DOUBLE_RETURN(std::fabs(x) <= 1, std::acos(x));
         PY_RETURN(py_funcs.py_acos);
 }
 
 const numeric numeric::atan() const {
+        DOUBLE_RETURN(true, std::atan(x));
         PY_RETURN(py_funcs.py_atan);
 }
 
 const numeric numeric::atan(const numeric& y) const {
+        double yd;
+        if (y.get_machine_double(yd)) {
+                DOUBLE_RETURN(x != 0 || yd != 0, std::atan2(yd, x));
+        }
         PY_RETURN2(py_funcs.py_atan2, y);
 }
 
 const numeric numeric::sinh() const {
+        DOUBLE_RETURN(true, std::sinh(x));
         PY_RETURN(py_funcs.py_sinh);
 }
 
 const numeric numeric::cosh() const {
+        DOUBLE_RETURN(true, std::cosh(x));
         PY_RETURN(py_funcs.py_cosh);
 }
 
 const numeric numeric::tanh() const {
+        DOUBLE_RETURN(true, std::tanh(x));
         PY_RETURN(py_funcs.py_tanh);
 }
 
 const numeric numeric::asinh() const {
+        DOUBLE_RETURN(true, std::asinh(x));
         PY_RETURN(py_funcs.py_asinh);
 }
 
 const numeric numeric::acosh() const {
+        DOUBLE_RETURN(x >= 1, std::acosh(x));
         PY_RETURN(py_funcs.py_acosh);
 }
 
 const numeric numeric::atanh() const {
+        DOUBLE_RETURN(std::fabs(x) < 1, std::atanh(x));
         PY_RETURN(py_funcs.py_atanh);
 }
 
@@ -2093,14 +2206,38 @@ const numeric numeric::Li2() const {
 }
 
 const numeric numeric::lgamma() const {
+        DOUBLE_RETURN(x > 0, std::lgamma(x));
         PY_RETURN(py_funcs.py_lgamma);
 }
 
 const numeric numeric::tgamma() const {
+        DOUBLE_RETURN(x > 0 || x != std::floor(x), std::tgamma(x));
         PY_RETURN(py_funcs.py_tgamma);
 }
 
+namespace {
+
+/** Digamma function of a real double which is not a pole, by reflection
+ *  to positive arguments, upward recurrence and the asymptotic series. */
+double digamma(double x)
+{
+        double r = 0;
+        if (x <= 0) {
+                r = -M_PI / std::tan(M_PI * x);
+                x = 1 - x;
+        }
+        for (; x < 10; x += 1)
+                r -= 1 / x;
+        const double f = 1 / (x * x);
+        return r + std::log(x) - 0.5 / x
+                - f * (1.0/12 - f * (1.0/120 - f * (1.0/252 - f * (1.0/240
+                - f * (1.0/132 - f * (691.0/32760 - f / 12))))));
+}
+
+} // anonymous namespace
+
 const numeric numeric::psi() const {
+        DOUBLE_RETURN(x > 0 || x != std::floor(x), digamma(x));
         PY_RETURN(py_funcs.py_psi);
 }
 
@@ -2195,6 +2332,7 @@ const numeric numeric::isqrt() const {
 }
 
 const numeric numeric::sqrt() const {
+        DOUBLE_RETURN(x >= 0, std::sqrt(x));
         PY_RETURN(py_funcs.py_sqrt);
 }
 
@@ -212,6 +212,11 @@ public:
         {
                 return t == PYOBJECT;
         }
+        bool is_double() const
+        {
+                return t == DOUBLE;
+        }
+        bool get_machine_double(double & d) const;
 	const numeric real() const;
 	const numeric imag() const;
 	const numeric numer() const;
@@ -289,6 +294,7 @@ extern PyObject *RR, *CC;
 
 // global functions
 
+bool is_machine_precision(PyObject* parent);
 void coerce(numeric& new_left, numeric& new_right, const numeric& left, const numeric& right);
 
 const numeric exp(const numeric &x);
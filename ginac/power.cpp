@@ -242,7 +242,7 @@ static void print_sym_pow(const print_context & c, const symbol &x, int exp)
 void power::do_print_csrc(const print_csrc & c, unsigned level) const
 {
 	if (is_a<print_csrc_cl_N>(c)) {
-		if (exponent.is_integer_one()) {
+		if (exponent.is_equal(_ex_1)) {
 			c.s << "recip(";
 			basis.print(c);
 			c.s << ')';
@@ -271,11 +271,19 @@ void power::do_print_csrc(const print_csrc & c, unsigned level) const
 		c.s << ')';
 
 	// <expr>^-1 is printed as "1.0/<expr>" or with the recip() function of CLN
-	} else if (exponent.is_integer_one()) {
+	} else if (exponent.is_equal(_ex_1)) {
 		c.s << "1.0/(";
 		basis.print(c);
 		c.s << ')';
 
+	// Square roots and their reciprocals use sqrt()
+	} else if (exponent.is_equal(_ex1_2) || exponent.is_equal(_ex_1_2)) {
+		if (exponent.is_equal(_ex_1_2))
+			c.s << "1.0/";
+		c.s << "sqrt(";
+		basis.print(c);
+		c.s << ')';
+
 	// Otherwise, use the pow() function
 	} else {
 		c.s << "pow(";
@@ -38,6 +38,7 @@
 #include <numeric>
 #include <stdexcept>
 #include <limits>
+#include <map>
 
 namespace GiNaC {
 
@@ -591,6 +592,18 @@ bool pseries::is_terminating() const
 	return seq.empty() || !is_order_function((seq.end()-1)->rest);
 }
 
+bool pseries::is_numeric_taylor() const
+{
+	for (const auto & elem : seq) {
+		const numeric & e = ex_to<numeric>(elem.coeff);
+		if (e.is_negative() || !e.is_integer())
+			return false;
+		if (!is_exactly_a<numeric>(elem.rest) && !is_order_function(elem.rest))
+			return false;
+	}
+	return true;
+}
+
 ex pseries::coeffop(size_t i) const
 {
 	if (i >=nops())
@@ -606,6 +619,245 @@ ex pseries::exponop(size_t i) const
 }
 
 
+/*
+ *  Dense arithmetic on coefficient arrays
+ *
+ *  Series with integer exponents are handled internally as an array of
+ *  coefficients c_0, c_1, ..., c_{n-1} together with a valuation v, standing
+ *  for the series  c_0*x^v + c_1*x^(v+1) + ... + Order(x^(v+n)).  The
+ *  routines below work on such arrays, truncated to n terms.  Arrays of
+ *  numeric coefficients get fast paths: Karatsuba multiplication and
+ *  Newton iteration for the inverse, exponential and logarithm.
+ */
+
+typedef std::vector<numeric> numvector;
+
+/** Length from which on numeric coefficient arrays are multiplied with
+ *  Karatsuba's method and exp/log/power use Newton iteration. */
+static const size_t karatsuba_threshold = 32;
+
+/** Fill a dense array with the coefficients of s at the exponents
+ *  v, v+1, ..., v+n-1.  The Order term is not part of the array. */
+static exvector dense_coeffs(const epvector & seq, int v, size_t n)
+{
+	exvector c(n, _ex0);
+	for (const auto & elem : seq) {
+		if (is_order_function(elem.rest))
+			break;
+		const int i = ex_to<numeric>(elem.coeff).to_int() - v;
+		if (i >= 0 && static_cast<size_t>(i) < n)
+			c[i] = elem.rest;
+	}
+	return c;
+}
+
+static bool all_numeric(const exvector & c)
+{
+	for (const auto & elem : c)
+		if (!is_exactly_a<numeric>(elem))
+			return false;
+	return true;
+}
+
+static numvector to_numvector(const exvector & c)
+{
+	numvector nc;
+	nc.reserve(c.size());
+	for (const auto & elem : c)
+		nc.push_back(ex_to<numeric>(elem));
+	return nc;
+}
+
+/** Truncated product of numeric arrays, the first n coefficients. */
+static numvector mul_schoolbook(const numvector & a, const numvector & b, size_t n)
+{
+	numvector c(n, *_num0_p);
+	for (size_t i=0; i<a.size() && i<n; ++i) {
+		if (a[i].is_zero())
+			continue;
+		for (size_t j=0; j<b.size() && i+j<n; ++j)
+			if (!b[j].is_zero())
+				c[i+j] = c[i+j].add(a[i].mul(b[j]));
+	}
+	return c;
+}
+
+static void add_shifted(numvector & c, const numvector & a, size_t shift)
+{
+	for (size_t i=0; i<a.size() && i+shift<c.size(); ++i)
+		c[i+shift] = c[i+shift].add(a[i]);
+}
+
+/** Full product of numeric arrays using Karatsuba's method. */
+static numvector mul_karatsuba(const numvector & a, const numvector & b)
+{
+	if (a.empty() || b.empty())
+		return numvector();
+	if (std::min(a.size(), b.size()) < karatsuba_threshold)
+		return mul_schoolbook(a, b, a.size()+b.size()-1);
+
+	// a == a0 + x^h*a1,  b == b0 + x^h*b1
+	const size_t h = std::max(a.size(), b.size())/2;
+	const numvector a0(a.begin(), a.begin()+std::min(h, a.size()));
+	const numvector a1(a.begin()+std::min(h, a.size()), a.end());
+	const numvector b0(b.begin(), b.begin()+std::min(h, b.size()));
+	const numvector b1(b.begin()+std::min(h, b.size()), b.end());
+
+	const numvector z0 = mul_karatsuba(a0, b0);
+	const numvector z2 = mul_karatsuba(a1, b1);
+	numvector as(a0), bs(b0);
+	as.resize(std::max(a0.size(), a1.size()), *_num0_p);
+	bs.resize(std::max(b0.size(), b1.size()), *_num0_p);
+	for (size_t i=0; i<a1.size(); ++i)
+		as[i] = as[i].add(a1[i]);
+	for (size_t i=0; i<b1.size(); ++i)
+		bs[i] = bs[i].add(b1[i]);
+	numvector z1 = mul_karatsuba(as, bs);
+	for (size_t i=0; i<z0.size(); ++i)
+		z1[i] = z1[i].sub(z0[i]);
+	for (size_t i=0; i<z2.size(); ++i)
+		z1[i] = z1[i].sub(z2[i]);
+
+	numvector c(a.size()+b.size()-1, *_num0_p);
+	add_shifted(c, z0, 0);
+	add_shifted(c, z1, h);
+	add_shifted(c, z2, 2*h);
+	return c;
+}
+
+/** Truncated product of numeric arrays, the first n coefficients. */
+static numvector mul_trunc(const numvector & a, const numvector & b, size_t n)
+{
+	if (std::min(std::min(a.size(), b.size()), n) < karatsuba_threshold)
+		return mul_schoolbook(a, b, n);
+	numvector c = mul_karatsuba(numvector(a.begin(), a.begin()+std::min(a.size(), n)),
+	                            numvector(b.begin(), b.begin()+std::min(b.size(), n)));
+	c.resize(n, *_num0_p);
+	return c;
+}
+
+/** Truncated product of arrays, the first n coefficients.  Each coefficient
+ *  is assembled as one sum instead of being accumulated term by term. */
+static exvector mul_trunc(const exvector & a, const exvector & b, size_t n)
+{
+	if (all_numeric(a) && all_numeric(b)) {
+		const numvector c = mul_trunc(to_numvector(a), to_numvector(b), n);
+		return exvector(c.begin(), c.end());
+	}
+
+	exvector c(n, _ex0);
+	exvector terms;
+	for (size_t k=0; k<n; ++k) {
+		terms.clear();
+		const size_t imin = k+1 > b.size() ? k+1-b.size() : 0;
+		for (size_t i=imin; i<=k && i<a.size(); ++i)
+			if (!a[i].is_zero() && !b[k-i].is_zero())
+				terms.push_back(a[i] * b[k-i]);
+		if (terms.size() == 1)
+			c[k] = terms[0];
+		else if (!terms.empty())
+			c[k] = (new add(terms))->setflag(status_flags::dynallocated);
+	}
+	return c;
+}
+
+/** Inverse of a numeric array with non-zero constant term, by Newton
+ *  iteration  b <- b + b*(1 - a*b), doubling the precision each step. */
+static numvector inv_newton(const numvector & a, size_t n)
+{
+	numvector b(1, a[0].inverse());
+	size_t len = 1;
+	while (len < n) {
+		len = std::min(2*len, n);
+		numvector e = mul_trunc(a, b, len);
+		for (auto & elem : e)
+			elem = elem.negative();
+		e[0] = e[0].add(*_num2_p);
+		b = mul_trunc(b, e, len);
+	}
+	return b;
+}
+
+/** Logarithm of a numeric array with constant term 1, which has constant
+ *  term 0:  log(a) == integral(a'/a). */
+static numvector log_dense(const numvector & a, size_t n)
+{
+	numvector l(n, *_num0_p);
+	if (n < 2)
+		return l;
+	if (n < karatsuba_threshold) {
+		// recurrence from a*l' == a':
+		//     k*l_k == k*a_k - sum(j*l_j*a_{k-j}, j=1..k-1)
+		for (size_t k=1; k<n; ++k) {
+			numeric s = k < a.size() ? a[k].mul(k) : *_num0_p;
+			for (size_t j=1; j<k; ++j)
+				if (k-j < a.size())
+					s = s.sub(l[j].mul(j).mul(a[k-j]));
+			l[k] = s.div(k);
+		}
+		return l;
+	}
+	numvector da(n-1, *_num0_p);
+	for (size_t k=1; k<n && k<a.size(); ++k)
+		da[k-1] = a[k].mul(k);
+	const numvector q = mul_trunc(da, inv_newton(a, n-1), n-1);
+	for (size_t k=1; k<n; ++k)
+		l[k] = q[k-1].div(k);
+	return l;
+}
+
+/** Exponential of a numeric array with constant term 0, by Newton
+ *  iteration  e <- e*(1 + f - log(e)). */
+static numvector exp_dense(const numvector & f, size_t n)
+{
+	numvector e(n, *_num0_p);
+	if (n == 0)
+		return e;
+	e[0] = *_num1_p;
+	if (n < karatsuba_threshold) {
+		// recurrence from e' == f'*e:
+		//     k*e_k == sum(j*f_j*e_{k-j}, j=1..k)
+		for (size_t k=1; k<n; ++k) {
+			numeric s = *_num0_p;
+			for (size_t j=1; j<=k && j<f.size(); ++j)
+				s = s.add(f[j].mul(j).mul(e[k-j]));
+			e[k] = s.div(k);
+		}
+		return e;
+	}
+	e.resize(1);
+	size_t len = 1;
+	while (len < n) {
+		len = std::min(2*len, n);
+		numvector d = log_dense(e, len);
+		for (size_t k=0; k<len; ++k) {
+			d[k] = d[k].negative();
+			if (k < f.size())
+				d[k] = d[k].add(f[k]);
+		}
+		d[0] = d[0].add(*_num1_p);
+		e = mul_trunc(e, d, len);
+	}
+	return e;
+}
+
+/** Assemble a pseries from a dense array with valuation v.  If with_order
+ *  is set, the series ends with Order(x^(v+c.size())). */
+static ex dense_to_pseries(const ex & var, const ex & point, int v,
+                           const exvector & c, bool with_order)
+{
+	epvector new_seq;
+	new_seq.reserve(c.size()+1);
+	for (size_t i=0; i<c.size(); ++i)
+		if (!c[i].is_zero())
+			new_seq.push_back(expair(c[i], numeric(v+static_cast<int>(i))));
+	if (with_order)
+		new_seq.push_back(expair(Order(_ex1), numeric(v+static_cast<int>(c.size()))));
+	return (new pseries(relational(var,point), new_seq))
+	       ->setflag(status_flags::dynallocated);
+}
+
+
 /*
  *  Implementations of series expansion
  */
@@ -835,29 +1087,18 @@ ex pseries::mul_series(const pseries &other) const
 	if (cdeg_max >= higher_order_c)
 		cdeg_max = higher_order_c - 1;
 
-        std::map<int, ex> map_int_ex1, map_int_ex2;
-        for (const auto& elem : seq)
-                map_int_ex1[ex_to<numeric>(elem.coeff).to_int()] = elem.rest;
-
-        if (other.var.is_equal(var))
-                for (const auto& elem : other.seq)
-                        map_int_ex2[ex_to<numeric>(elem.coeff).to_int()] = elem.rest;
-
-	for (int cdeg=cdeg_min; cdeg<=cdeg_max; ++cdeg) {
-		ex co = _ex0;
-		// c(i)=a(0)b(i)+...+a(i)b(0)
-		for (int i=a_min; cdeg-i>=b_min; ++i) {
-                        const auto& it1 = map_int_ex1.find(i);
-                        if (it1 == map_int_ex1.end())
-                                continue;
-                        const auto& it2 = map_int_ex2.find(cdeg-i);
-                        if (it2 == map_int_ex2.end())
-                                continue;
-			if (!is_order_function(it1->second) && !is_order_function(it2->second))
-				co += it1->second * it2->second;
-		}
-		if (!co.is_zero())
-			new_seq.push_back(expair(co, numeric(cdeg)));
+	// The coefficients are multiplied as dense arrays starting at the
+	// lowest exponents.  Order terms are left out since they only determine
+	// higher_order_c.
+	if (cdeg_max >= cdeg_min) {
+		const size_t n = cdeg_max - cdeg_min + 1;
+		const exvector a = dense_coeffs(seq, a_min, std::min<size_t>(n, a_max - a_min + 1));
+		const exvector b = dense_coeffs(other.seq, b_min, std::min<size_t>(n, b_max - b_min + 1));
+		const exvector c = mul_trunc(a, b, n);
+		new_seq.reserve(n + 1);
+		for (size_t i=0; i<n; ++i)
+			if (!c[i].is_zero())
+				new_seq.push_back(expair(c[i], numeric(cdeg_min + static_cast<int>(i))));
 	}
 	if (higher_order_c < std::numeric_limits<int>::max())
 		new_seq.push_back(expair(Order(_ex1), numeric(higher_order_c)));
@@ -1034,29 +1275,66 @@ ex pseries::power_const(const numeric &p, int deg) const
 	if (seq.size() == 1 && is_order_function(seq[0].rest) && p.real().is_negative())
 		throw pole_error("pseries::power_const(): division by zero",1);
 	
+	// Gather the coefficients of A(x)/x^ldeg into a dense array.  The
+	// result is only known up to the relative position of an Order term.
+	int ordpos = numcoeff;
+	for (const auto & elem : seq)
+		if (is_order_function(elem.rest)) {
+			ordpos = std::min(ordpos, ex_to<numeric>(elem.coeff).to_int() - ldeg);
+			break;
+		}
+	if (ordpos <= 0) {
+		// O(x^m)^p == O(x^(p*m))
+		epvector epv;
+		epv.push_back(expair(Order(_ex1), p * ldeg));
+		return (new pseries(relational(var,point), epv))
+		       ->setflag(status_flags::dynallocated);
+	}
+	const exvector a = dense_coeffs(seq, ldeg, numcoeff);
+
 	// Compute coefficients of the powered series
 	exvector co;
-	co.reserve(numcoeff);
-	co.push_back(power(coeff(var, ldeg), p));
-	for (int i=1; i<numcoeff; ++i) {
-		ex sum = _ex0;
-		for (int j=1; j<=i; ++j) {
-			ex c = coeff(var, j + ldeg);
-			if (is_order_function(c)) {
+	if (ordpos >= static_cast<int>(karatsuba_threshold) && all_numeric(a)) {
+		// numeric coefficients: C(x) = a_0^p*exp(p*log(A(x)/a_0))
+		const numeric & a0 = ex_to<numeric>(a[0]);
+		numvector na = to_numvector(a);
+		for (auto & elem : na)
+			elem = elem.div(a0);
+		numvector l = log_dense(na, ordpos);
+		for (auto & elem : l)
+			elem = elem.mul(p);
+		const numvector e = exp_dense(l, ordpos);
+		const ex c0 = power(a0, p);
+		co.reserve(numcoeff);
+		for (const auto & elem : e)
+			co.push_back(c0 * elem);
+		if (ordpos < numcoeff)
+			co.push_back(Order(_ex1));
+	} else {
+		co.reserve(numcoeff);
+		co.push_back(power(a[0], p));
+		exvector terms;
+		for (int i=1; i<numcoeff; ++i) {
+			if (i >= ordpos) {
 				co.push_back(Order(_ex1));
 				break;
-			} else
-				sum += (p * j - (i - j)) * co[i - j] * c;
+			}
+			terms.clear();
+			for (int j=1; j<=i; ++j)
+				if (!a[j].is_zero() && !co[i - j].is_zero())
+					terms.push_back((p * j - (i - j)) * co[i - j] * a[j]);
+			const ex sum = (new add(terms))->setflag(status_flags::dynallocated);
+			co.push_back(sum / a[0] / i);
 		}
-		co.push_back(sum / coeff(var, ldeg) / i);
 	}
 	
 	// Construct new series (of non-zero coefficients)
 	epvector new_seq;
 	bool higher_order = false;
-	for (int i=0; i<numcoeff; ++i) {
+	new_seq.reserve(co.size() + 1);
+	for (size_t i=0; i<co.size(); ++i) {
 		if (!co[i].is_zero())
-			new_seq.push_back(expair(co[i], p * ldeg + i));
+			new_seq.push_back(expair(co[i], p * ldeg + static_cast<int>(i)));
 		if (is_order_function(co[i])) {
 			higher_order = true;
 			break;
@@ -1069,6 +1347,64 @@ ex pseries::power_const(const numeric &p, int deg) const
 }
 
 
+/** Number of leading coefficients of a Taylor series that are known, i.e.
+ *  the exponent of its Order term, but at most deg. */
+static int known_coeffs(const epvector & seq, int deg)
+{
+	if (!seq.empty() && is_order_function(seq.back().rest))
+		return std::min(deg, ex_to<numeric>(seq.back().coeff).to_int());
+	return deg;
+}
+
+/** Compute the exponential of a Taylor series with numeric coefficients,
+ *  see is_numeric_taylor().  Instead of differentiating exp(A(x))
+ *  repeatedly the coefficients are computed directly from those of A(x):
+ *      exp(A(x)) = exp(a_0)*exp(A(x)-a_0).
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::exp_series(int deg) const
+{
+	GINAC_ASSERT(is_numeric_taylor());
+	const int n = known_coeffs(seq, deg);
+	if (n <= 0)
+		return dense_to_pseries(var, point, 0, exvector(), true);
+
+	numvector f = to_numvector(dense_coeffs(seq, 0, n));
+	const ex e0 = exp(ex(f[0]));
+	f[0] = *_num0_p;
+	const numvector e = exp_dense(f, n);
+	exvector co;
+	co.reserve(n);
+	for (const auto & elem : e)
+		co.push_back(e0 * elem);
+	return dense_to_pseries(var, point, 0, co, true);
+}
+
+/** Compute the logarithm of a Taylor series with numeric coefficients and
+ *  non-zero constant term, see is_numeric_taylor():
+ *      log(A(x)) = log(a_0) + log(A(x)/a_0).
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::log_series(int deg) const
+{
+	GINAC_ASSERT(is_numeric_taylor());
+	const int n = known_coeffs(seq, deg);
+	if (n <= 0)
+		return dense_to_pseries(var, point, 0, exvector(), true);
+
+	numvector a = to_numvector(dense_coeffs(seq, 0, n));
+	const numeric a0 = a[0];
+	if (a0.is_zero())
+		throw std::domain_error("pseries::log_series(): constant term is zero");
+	for (auto & elem : a)
+		elem = elem.div(a0);
+	const numvector l = log_dense(a, n);
+	exvector co(l.begin(), l.end());
+	co[0] = log(ex(a0));
+	return dense_to_pseries(var, point, 0, co, true);
+}
+
+
 /** Return a new pseries object with the powers shifted by deg. */
 pseries pseries::shift_exponents(int deg) const
 {
@@ -1268,6 +1604,491 @@ ex integral::series(const relational & r, int order, unsigned options) const
 }
 
 
+/*
+ *  Lazy series expansion
+ */
+
+/** How far beyond its lower bound the leading coefficient of a lazy series
+ *  is searched for before giving up. */
+static const int lazy_valuation_limit = 64;
+
+/** A node in the tree of lazy expansions.  Each node knows a lower bound of
+ *  its exponents and computes its coefficients one after the other,
+ *  remembering all of them. */
+class lazy_series_node
+{
+public:
+	explicit lazy_series_node(int l) : low(l) {}
+	virtual ~lazy_series_node() {}
+
+	/** Lower bound of the exponents. */
+	int lower_bound() const { return low; }
+
+	/** Coefficient of the k-th power of the expansion variable. */
+	ex coeff(int k)
+	{
+		if (k < low)
+			return _ex0;
+		while (cache.size() <= static_cast<size_t>(k - low))
+			cache.push_back(compute(low + static_cast<int>(cache.size())));
+		return cache[k - low];
+	}
+
+	/** Exponent of the first non-zero coefficient. */
+	int valuation()
+	{
+		for (int k=low; k<low+lazy_valuation_limit; ++k)
+			if (!coeff(k).is_zero())
+				return k;
+		throw std::runtime_error("lazy_series: unable to determine leading term");
+	}
+
+protected:
+	/** Compute the coefficient of the k-th power.  All coefficients with
+	 *  lower exponents are in the cache already. */
+	virtual ex compute(int k) = 0;
+
+	int low;
+	exvector cache;
+};
+
+typedef std::shared_ptr<lazy_series_node> lazy_node_ptr;
+
+/** Finitely many known coefficients: constants and the variable itself. */
+class lazy_poly_node : public lazy_series_node
+{
+public:
+	lazy_poly_node(int l, const exvector & c) : lazy_series_node(l), co(c) {}
+protected:
+	ex compute(int k) override
+	{
+		const size_t i = k - low;
+		return i < co.size() ? co[i] : _ex0;
+	}
+	exvector co;
+};
+
+class lazy_add_node : public lazy_series_node
+{
+public:
+	explicit lazy_add_node(const std::vector<lazy_node_ptr> & t)
+	  : lazy_series_node(std::numeric_limits<int>::max()), terms(t)
+	{
+		for (const auto & elem : terms)
+			low = std::min(low, elem->lower_bound());
+	}
+protected:
+	ex compute(int k) override
+	{
+		exvector s;
+		s.reserve(terms.size());
+		for (const auto & elem : terms) {
+			const ex c = elem->coeff(k);
+			if (!c.is_zero())
+				s.push_back(c);
+		}
+		return (new add(s))->setflag(status_flags::dynallocated);
+	}
+	std::vector<lazy_node_ptr> terms;
+};
+
+/** Cauchy product:  c_k = sum(a_i*b_{k-i}). */
+class lazy_mul_node : public lazy_series_node
+{
+public:
+	lazy_mul_node(const lazy_node_ptr & a_, const lazy_node_ptr & b_)
+	  : lazy_series_node(a_->lower_bound() + b_->lower_bound()), a(a_), b(b_) {}
+protected:
+	ex compute(int k) override
+	{
+		exvector s;
+		for (int i=a->lower_bound(); i<=k-b->lower_bound(); ++i) {
+			const ex ca = a->coeff(i);
+			if (ca.is_zero())
+				continue;
+			const ex cb = b->coeff(k - i);
+			if (!cb.is_zero())
+				s.push_back(ca * cb);
+		}
+		return (new add(s))->setflag(status_flags::dynallocated);
+	}
+	lazy_node_ptr a, b;
+};
+
+/** Numeric power of a series by Euler's recurrence, see
+ *  pseries::power_const(). */
+class lazy_power_node : public lazy_series_node
+{
+public:
+	lazy_power_node(const lazy_node_ptr & b, int v, const numeric & p_)
+	  : lazy_series_node((p_ * v).to_int()), basis(b), val(v), p(p_) {}
+protected:
+	ex compute(int k) override
+	{
+		const int i = k - low;
+		const ex a0 = basis->coeff(val);
+		if (i == 0)
+			return power(a0, p);
+		exvector s;
+		for (int j=1; j<=i; ++j) {
+			const ex aj = basis->coeff(val + j);
+			if (!aj.is_zero())
+				s.push_back((p * j - (i - j)) * cache[i - j] * aj);
+		}
+		const ex sum = (new add(s))->setflag(status_flags::dynallocated);
+		return sum / a0 / i;
+	}
+	lazy_node_ptr basis;
+	int val;
+	numeric p;
+};
+
+/** exp(f) for f without negative powers:  k*e_k = sum(j*f_j*e_{k-j}). */
+class lazy_exp_node : public lazy_series_node
+{
+public:
+	explicit lazy_exp_node(const lazy_node_ptr & f_) : lazy_series_node(0), f(f_) {}
+protected:
+	ex compute(int k) override
+	{
+		if (k == 0)
+			return exp(f->coeff(0));
+		exvector s;
+		for (int j=1; j<=k; ++j) {
+			const ex fj = f->coeff(j);
+			if (!fj.is_zero())
+				s.push_back(j * fj * cache[k - j]);
+		}
+		return (new add(s))->setflag(status_flags::dynallocated) / k;
+	}
+	lazy_node_ptr f;
+};
+
+/** log(f) for f with non-zero constant term:
+ *  k*a_0*l_k = k*a_k - sum(j*l_j*a_{k-j}). */
+class lazy_log_node : public lazy_series_node
+{
+public:
+	explicit lazy_log_node(const lazy_node_ptr & f_) : lazy_series_node(0), f(f_) {}
+protected:
+	ex compute(int k) override
+	{
+		const ex a0 = f->coeff(0);
+		if (k == 0)
+			return log(a0);
+		exvector s;
+		s.push_back(f->coeff(k));
+		for (int j=1; j<k; ++j) {
+			const ex akj = f->coeff(k - j);
+			if (!akj.is_zero())
+				s.push_back(numeric(-j, k) * cache[j] * akj);
+		}
+		return (new add(s))->setflag(status_flags::dynallocated) / a0;
+	}
+	lazy_node_ptr f;
+};
+
+/** sin(f) and cos(f), or sinh(f) and cosh(f), for f without negative
+ *  powers, from s' = f'*c and c' = -f'*s (c' = f'*s for cosh):
+ *  k*s_k = sum(j*f_j*c_{k-j}),  k*c_k = -sum(j*f_j*s_{k-j}).  The node
+ *  returns one of them and keeps the other one alongside. */
+class lazy_sincos_node : public lazy_series_node
+{
+public:
+	lazy_sincos_node(const lazy_node_ptr & f_, bool cosine_, bool hyperbolic_)
+	  : lazy_series_node(0), f(f_), cosine(cosine_), hyperbolic(hyperbolic_) {}
+protected:
+	ex compute(int k) override
+	{
+		if (k == 0) {
+			const ex f0 = f->coeff(0);
+			const ex s0 = hyperbolic ? sinh(f0) : sin(f0);
+			const ex c0 = hyperbolic ? cosh(f0) : cos(f0);
+			other.push_back(cosine ? s0 : c0);
+			return cosine ? c0 : s0;
+		}
+		const exvector & s = cosine ? other : cache;
+		const exvector & c = cosine ? cache : other;
+		exvector ss, cs;
+		for (int j=1; j<=k; ++j) {
+			const ex fj = f->coeff(j);
+			if (fj.is_zero())
+				continue;
+			ss.push_back(j * fj * c[k - j]);
+			cs.push_back(j * fj * s[k - j]);
+		}
+		const ex sk = (new add(ss))->setflag(status_flags::dynallocated) / k;
+		ex ck = (new add(cs))->setflag(status_flags::dynallocated) / k;
+		if (!hyperbolic)
+			ck = -ck;
+		other.push_back(cosine ? sk : ck);
+		return cosine ? ck : sk;
+	}
+	lazy_node_ptr f;
+	bool cosine, hyperbolic;
+	exvector other;  ///< coefficients of the companion function
+};
+
+/** tan(f) or tanh(f) for f without negative powers and tan(f_0) finite,
+ *  from t' = f'*u with u = 1+t^2 (u = 1-t^2 for tanh):
+ *  k*t_k = sum(j*f_j*u_{k-j}). */
+class lazy_tan_node : public lazy_series_node
+{
+public:
+	lazy_tan_node(const lazy_node_ptr & f_, bool hyperbolic_)
+	  : lazy_series_node(0), f(f_), hyperbolic(hyperbolic_) {}
+protected:
+	ex compute(int k) override
+	{
+		if (k == 0) {
+			const ex t0 = hyperbolic ? tanh(f->coeff(0)) : tan(f->coeff(0));
+			push_u(t0);
+			return t0;
+		}
+		exvector s;
+		for (int j=1; j<=k; ++j) {
+			const ex fj = f->coeff(j);
+			if (!fj.is_zero())
+				s.push_back(j * fj * u[k - j]);
+		}
+		const ex tk = (new add(s))->setflag(status_flags::dynallocated) / k;
+		push_u(tk);
+		return tk;
+	}
+	/** Append u_m, m = number of known t_i, given t_m. */
+	void push_u(const ex & tm)
+	{
+		const size_t m = u.size();
+		exvector s;
+		if (m == 0)
+			s.push_back(_ex1);
+		for (size_t i=0; i<=m; ++i) {
+			const ex & ti = i < m ? cache[i] : tm;
+			const ex & tmi = i > 0 ? cache[m - i] : tm;
+			if (!ti.is_zero() && !tmi.is_zero())
+				s.push_back(hyperbolic ? -ti * tmi : ti * tmi);
+		}
+		u.push_back((new add(s))->setflag(status_flags::dynallocated));
+	}
+	lazy_node_ptr f;
+	bool hyperbolic;
+	exvector u;  ///< coefficients of 1+t^2 or 1-t^2
+};
+
+/** Everything else is expanded with ex::series(), doubling the order each
+ *  time more coefficients are needed. */
+class lazy_generic_node : public lazy_series_node
+{
+public:
+	lazy_generic_node(const ex & e_, const relational & r, unsigned opt)
+	  : lazy_series_node(0), e(e_), rel(r), options(opt), known(0), order(0)
+	{
+		expand_to(8);
+		if (!co.empty())
+			low = co.begin()->first;
+		else if (known < std::numeric_limits<int>::max())
+			low = known;
+	}
+protected:
+	void expand_to(int ord)
+	{
+		const ex s = e.series(rel, ord, options);
+		const pseries & ps = ex_to<pseries>(s);
+		order = ord;
+		known = ps.is_terminating() ? std::numeric_limits<int>::max()
+		                            : exponent(ps.exponop(ps.nops() - 1));
+		co.clear();
+		for (size_t i=0; i<ps.nops(); ++i)
+			if (!is_order_function(ps.coeffop(i)))
+				co[exponent(ps.exponop(i))] = ps.coeffop(i);
+	}
+	static int exponent(const ex & x)
+	{
+		if (!x.info(info_flags::integer))
+			throw std::runtime_error("lazy_series: trying to assemble a Puiseux series");
+		return ex_to<numeric>(x).to_int();
+	}
+	ex compute(int k) override
+	{
+		for (int tries=0; k >= known; ++tries) {
+			if (tries > 16)
+				throw std::runtime_error("lazy_series: series expansion does not converge");
+			expand_to(std::max(2 * order, k + 1));
+		}
+		const auto it = co.find(k);
+		return it == co.end() ? _ex0 : it->second;
+	}
+	ex e;
+	relational rel;
+	unsigned options;
+	int known;     ///< coefficients below this exponent are known
+	int order;     ///< order of the last expansion
+	std::map<int, ex> co;
+};
+
+/** Builds the tree of lazy expansions of an expression, sharing the nodes
+ *  of common subexpressions. */
+class lazy_series_builder
+{
+public:
+	lazy_series_builder(const relational & r, unsigned opt)
+	  : rel(r), var(r.lhs()), point(r.rhs()), options(opt) {}
+
+	lazy_node_ptr build(const ex & e)
+	{
+		const auto it = nodes.find(e);
+		if (it != nodes.end())
+			return it->second;
+		lazy_node_ptr n = make(e);
+		nodes[e] = n;
+		return n;
+	}
+
+protected:
+	lazy_node_ptr generic(const ex & e)
+	{
+		return std::make_shared<lazy_generic_node>(e, rel, options);
+	}
+
+	lazy_node_ptr make(const ex & e)
+	{
+		if (!e.has(var))
+			return std::make_shared<lazy_poly_node>(0, exvector(1, e));
+		if (e.is_equal(var)) {
+			if (point.is_zero())
+				return std::make_shared<lazy_poly_node>(1, exvector(1, _ex1));
+			exvector c;
+			c.push_back(point);
+			c.push_back(_ex1);
+			return std::make_shared<lazy_poly_node>(0, c);
+		}
+		if (is_exactly_a<add>(e)) {
+			std::vector<lazy_node_ptr> terms;
+			for (size_t i=0; i<e.nops(); ++i)
+				terms.push_back(build(e.op(i)));
+			return std::make_shared<lazy_add_node>(terms);
+		}
+		if (is_exactly_a<mul>(e)) {
+			lazy_node_ptr n = build(e.op(0));
+			for (size_t i=1; i<e.nops(); ++i)
+				n = std::make_shared<lazy_mul_node>(n, build(e.op(i)));
+			return n;
+		}
+		if (is_exactly_a<power>(e) && is_exactly_a<numeric>(e.op(1)))
+			return make_power(e);
+		if (is_ex_the_function(e, exp)) {
+			const lazy_node_ptr f = build(e.op(0));
+			if (f->lower_bound() >= 0 || f->valuation() >= 0)
+				return std::make_shared<lazy_exp_node>(f);
+		}
+		if (is_ex_the_function(e, log)) {
+			const lazy_node_ptr f = build(e.op(0));
+			if (f->valuation() == 0)
+				return std::make_shared<lazy_log_node>(f);
+		}
+		const bool sincos = is_ex_the_function(e, sin) || is_ex_the_function(e, cos);
+		const bool sinhcosh = is_ex_the_function(e, sinh) || is_ex_the_function(e, cosh);
+		if (sincos || sinhcosh) {
+			const lazy_node_ptr f = build(e.op(0));
+			if (f->lower_bound() >= 0 || f->valuation() >= 0)
+				return std::make_shared<lazy_sincos_node>(f,
+						is_ex_the_function(e, cos) || is_ex_the_function(e, cosh),
+						sinhcosh);
+		}
+		if (is_ex_the_function(e, tan) || is_ex_the_function(e, tanh)) {
+			const bool hyperbolic = is_ex_the_function(e, tanh);
+			const lazy_node_ptr f = build(e.op(0));
+			if ((f->lower_bound() >= 0 || f->valuation() >= 0)
+			    && !ex(hyperbolic ? cosh(f->coeff(0)) : cos(f->coeff(0))).is_zero())
+				return std::make_shared<lazy_tan_node>(f, hyperbolic);
+		}
+		return generic(e);
+	}
+
+	lazy_node_ptr make_power(const ex & e)
+	{
+		const lazy_node_ptr b = build(e.op(0));
+		const numeric & p = ex_to<numeric>(e.op(1));
+		if (p.is_pos_integer() && p.to_int() <= 64) {
+			// binary powering keeps polynomial coefficients polynomial
+			int n = p.to_int();
+			lazy_node_ptr result, sq = b;
+			for (;;) {
+				if (n & 1)
+					result = result ? std::make_shared<lazy_mul_node>(result, sq) : sq;
+				n >>= 1;
+				if (n == 0)
+					break;
+				sq = std::make_shared<lazy_mul_node>(sq, sq);
+			}
+			return result;
+		}
+		const int v = b->valuation();
+		if (!(p * v).is_integer())
+			return generic(e);
+		return std::make_shared<lazy_power_node>(b, v, p);
+	}
+
+	relational rel;
+	ex var;
+	ex point;
+	unsigned options;
+	std::map<ex, lazy_node_ptr, ex_is_less> nodes;
+};
+
+/** Prepare the lazy series expansion of e.  Nothing beyond the leading
+ *  terms of some subexpressions is computed yet.
+ *
+ *  @param e  expression to expand
+ *  @param r  expansion relation, lhs holds variable and rhs holds point
+ *  @param options  of class series_options */
+lazy_series::lazy_series(const ex & e, const ex & r, unsigned options)
+{
+	relational rel_;
+	if (is_exactly_a<relational>(r))
+		rel_ = ex_to<relational>(r);
+	else if (is_exactly_a<symbol>(r))
+		rel_ = relational(r,_ex0);
+	else
+		throw (std::logic_error("lazy_series::lazy_series(): expansion point has unknown type"));
+	var = rel_.lhs();
+	point = rel_.rhs();
+
+	lazy_series_builder b(rel_, options);
+	if (point.info(info_flags::infinity))
+		root = std::make_shared<lazy_generic_node>(e, rel_, options);
+	else
+		root = b.build(e);
+}
+
+/** Coefficient of (var-point)^n, computing it and all lower coefficients
+ *  not known yet. */
+ex lazy_series::coeff(int n) const
+{
+	return root->coeff(n);
+}
+
+/** Exponent of the leading term. */
+int lazy_series::ldegree() const
+{
+	return root->valuation();
+}
+
+/** The truncated series of the expression as ex::series() would return it,
+ *  except that there is always an Order term.
+ *
+ *  @param order  truncation order of series calculation
+ *  @return an expression holding a pseries object */
+ex lazy_series::series(int order) const
+{
+	const int low = root->lower_bound();
+	exvector c;
+	for (int k=low; k<order; ++k)
+		c.push_back(root->coeff(k));
+	return dense_to_pseries(var, point, std::min(low, order), c, true);
+}
+
+
 /** Compute the truncated series expansion of an expression.
  *  This function returns an expression containing an object of class pseries 
  *  to represent the series. If the series does not terminate within the given
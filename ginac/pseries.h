@@ -26,6 +26,8 @@
 #include "basic.h"
 #include "expairseq.h"
 
+#include <memory>
+
 namespace GiNaC {
 
 /** This class holds a extended truncated power series (positive and negative
@@ -87,6 +89,10 @@ public:
 	 *  false otherwise. */
 	bool is_terminating() const;
 
+	/** Returns true if this is a Taylor series (only non-negative integer
+	 *  exponents) whose coefficients are all numbers. */
+	bool is_numeric_taylor() const;
+
 	/** Get coefficients and exponents. */
 	ex coeffop(size_t i) const;
 	ex exponop(size_t i) const;
@@ -95,6 +101,8 @@ public:
 	ex mul_const(const numeric &other) const;
 	ex mul_series(const pseries &other) const;
 	ex power_const(const numeric &p, int deg) const;
+	ex exp_series(int deg) const;
+	ex log_series(int deg) const;
 	pseries shift_exponents(int deg) const;
 
 protected:
@@ -117,6 +125,40 @@ protected:
 };
 
 
+class lazy_series_node;
+
+/** Series expansion whose coefficients are computed on demand and cached.
+ *  Asking for higher orders later on does not recompute the coefficients
+ *  already known: sums, products, numeric powers, exp() and log() are
+ *  expanded term by term through recurrences, everything else through
+ *  ex::series() at geometrically growing orders. */
+class lazy_series
+{
+public:
+	lazy_series(const ex & e, const ex & r, unsigned options = 0);
+
+	/** Get the expansion variable. */
+	ex get_var() const {return var;}
+
+	/** Get the expansion point. */
+	ex get_point() const {return point;}
+
+	ex coeff(int n) const;
+	int ldegree() const;
+	ex series(int order) const;
+
+protected:
+	/** Root of the tree of expansions of subexpressions */
+	std::shared_ptr<lazy_series_node> root;
+
+	/** Series variable (holds a symbol) */
+	ex var;
+
+	/** Expansion point */
+	ex point;
+};
+
+
 // utility functions
 
 /** Convert the pseries object embedded in an expression to an ordinary
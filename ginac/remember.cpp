@@ -24,8 +24,12 @@
 #include "function.h"
 #include "utils.h"
 #include "remember.h"
+#include "cache.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
+#include <ostream>
 
 namespace GiNaC {
 
@@ -54,82 +58,68 @@ bool remember_table_entry::is_equal(function const & f) const
 
 unsigned long remember_table_entry::access_counter = 0;
 
+/** Estimated number of bytes used by this entry and its bookkeeping in a
+ *  remember_table, not counting the expressions themselves which are
+ *  shared with the rest of the program. */
+size_t remember_table_entry::memory_size() const
+{
+	// list node and index node, each about three pointers of overhead
+	return sizeof(*this) + seq.capacity()*sizeof(ex) + 6*sizeof(void *);
+}
+
 //////////
-// class remember_table_list
+// class remember_tables_cache
 //////////
 
-remember_table_list::remember_table_list(unsigned as, unsigned strat)
+/** The remember tables of all functions, as seen by the cache_manager. */
+class remember_tables_cache : public managed_cache {
+public:
+	remember_tables_cache() : managed_cache("remember tables") {}
+	void evict(size_t amount) override;
+	void flush() override;
+	void show_statistics(std::ostream & os, unsigned level) const override;
+	using managed_cache::account;
+};
+
+static remember_tables_cache & remember_cache()
 {
-	max_assoc_size = as;
-	remember_strategy = strat;
+	static auto rc = new remember_tables_cache;
+	return *rc;
 }
 
-
-void remember_table_list::add_entry(function const & f, ex const & result)
+/** Remove entries from the largest tables, in the order given by their
+ *  remember strategies. */
+void remember_tables_cache::evict(size_t amount)
 {
-	if ((max_assoc_size!=0) &&
-		(remember_strategy!=remember_strategies::delete_never) &&
-		(size()>=max_assoc_size)) {
-		// table is full, we must delete an older entry
-		GINAC_ASSERT(size()>0); // there must be at least one entry
-		
-		switch (remember_strategy) {
-		case remember_strategies::delete_cyclic: {
-			// delete oldest entry (first in list)
-			erase(begin());
-			break;
-		}
-		case remember_strategies::delete_lru: {
-			// delete least recently used entry
-			auto it = begin();
-			auto lowest_access_it = it;
-			unsigned long lowest_access = (*it).get_last_access();
-			++it;
-			while (it!=end()) {
-				if ((*it).get_last_access()<lowest_access) {
-					lowest_access = (*it).get_last_access();
-					lowest_access_it = it;
-				}
-				++it;
-			}
-			erase(lowest_access_it);
-			break;
-		}
-		case remember_strategies::delete_lfu: {
-			// delete least frequently used entry
-			auto it = begin();
-			auto lowest_hits_it = it;
-			unsigned lowest_hits = (*it).get_successful_hits();
-			++it;
-			while (it!=end()) {
-				if ((*it).get_successful_hits()<lowest_hits) {
-					lowest_hits = (*it).get_successful_hits();
-					lowest_hits_it = it;
-				}
-				++it;
-			}
-			erase(lowest_hits_it);
+	std::deque<remember_table> & tables = remember_table::remember_tables();
+	const size_t target = amount < memory_size() ? memory_size() - amount : 0;
+	while (memory_size() > target) {
+		auto largest = std::max_element(tables.begin(), tables.end(),
+			[](const remember_table & a, const remember_table & b)
+			{ return a.memory_size() < b.memory_size(); });
+		if (largest == tables.end() || largest->size() == 0)
 			break;
-		}
-		default:
-			throw(std::logic_error("remember_table_list::add_entry(): invalid remember_strategy"));
-        }
-		GINAC_ASSERT(size()==max_assoc_size-1);
+		// take a fair share from the largest table at a time
+		const size_t share = largest->memory_size() / 2;
+		const size_t stop = largest->memory_size() > share ? largest->memory_size() - share : 0;
+		while (largest->size() != 0 && largest->memory_size() > stop
+		       && memory_size() > target)
+			largest->remove_victim();
 	}
-	push_back(remember_table_entry(f,result));
 }
 
-bool remember_table_list::lookup_entry(function const & f, ex & result) const
+void remember_tables_cache::flush()
 {
-	auto i = begin(), iend = end();
-	while (i != iend) {
-		if (i->is_equal(f)) {
-			result = i->get_result();
-			return true;
-		}
-		++i;
-	}
-	return false;
+	for (auto & t : remember_table::remember_tables())
+		t.clear_all_entries();
+}
+
+void remember_tables_cache::show_statistics(std::ostream & os, unsigned level) const
+{
+	managed_cache::show_statistics(os, level);
+	for (const auto & t : remember_table::remember_tables())
+		if (t.size() != 0)
+			t.show_statistics(os, level + 2);
 }
 
 //////////
@@ -137,53 +127,205 @@ bool remember_table_list::lookup_entry(function const & f, ex & result) const
 //////////
 
 remember_table::remember_table()
+  : max_entries(0), remember_strategy(remember_strategies::delete_never),
+    num_entries(0), bytes(0), lookups(0), hits(0)
 {
-	table_size=0;
-	max_assoc_size=0;
-	remember_strategy=remember_strategies::delete_never;
 }
 
-remember_table::remember_table(unsigned s, unsigned as, unsigned strat)
-  : max_assoc_size(as), remember_strategy(strat)
+remember_table::remember_table(unsigned s, unsigned as, unsigned strat,
+                               const std::string & n)
+  : remember_strategy(strat), num_entries(0), bytes(0), lookups(0), hits(0),
+    name(n)
 {
-	// we keep max_assoc_size and remember_strategy if we need to clear
-	// all entries
-	
+	if (strat > remember_strategies::delete_cyclic)
+		throw(std::logic_error("remember_table::remember_table(): invalid remember_strategy"));
+
 	// use some power of 2 next to s
-	table_size = 1 << log2(s);
-	init_table();
+	const size_t table_size = 1 << log2(s);
+	if (as == 0 || strat == remember_strategies::delete_never)
+		max_entries = 0;
+	else
+		max_entries = table_size * as;
+	if (max_entries != 0)
+		index.reserve(max_entries);
+}
+
+// The index holds iterators into the buckets, so copies must rebuild it.
+remember_table::remember_table(const remember_table & other)
+  : max_entries(other.max_entries),
+    remember_strategy(other.remember_strategy),
+    num_entries(0), bytes(0), lookups(other.lookups), hits(other.hits),
+    name(other.name)
+{
+	for (const auto & b : other.buckets)
+		for (const auto & e : b.entries)
+			insert(e);
+}
+
+remember_table::~remember_table()
+{
+	if (bytes != 0)
+		remember_cache().account(-static_cast<std::ptrdiff_t>(bytes));
+}
+
+remember_table & remember_table::operator=(const remember_table & other)
+{
+	if (this != &other) {
+		remember_table tmp(other);
+		buckets.swap(tmp.buckets);
+		index.swap(tmp.index);
+		max_entries = tmp.max_entries;
+		remember_strategy = tmp.remember_strategy;
+		num_entries = tmp.num_entries;
+		// tmp releases the bytes of the old entries
+		std::swap(bytes, tmp.bytes);
+		lookups = tmp.lookups;
+		hits = tmp.hits;
+		name.swap(tmp.name);
+	}
+	return *this;
 }
 
-bool remember_table::lookup_entry(function const & f, ex & result) const
+bool remember_table::lookup_entry(function const & f, ex & result)
 {
-	long entry = f.gethash() & (table_size-1);
-	GINAC_ASSERT(entry<size());
-	return operator[](entry).lookup_entry(f,result);
+	++lookups;
+	auto range = index.equal_range(f.gethash());
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.second->is_equal(f)) {
+			result = it->second.second->get_result();
+			++hits;
+			touch(it);
+			return true;
+		}
+	}
+	return false;
 }
 
 void remember_table::add_entry(function const & f, ex const & result)
 {
-	long entry = f.gethash() & (table_size-1);
-	GINAC_ASSERT(entry<size());
-	operator[](entry).add_entry(f,result);
-}        
+	if (max_entries != 0 && num_entries >= max_entries) {
+		// table is full, we must delete an older entry
+		remove_victim();
+	}
+	insert(remember_table_entry(f, result));
+}
 
 void remember_table::clear_all_entries()
 {
-	clear();
-	init_table();
+	buckets.clear();
+	index.clear();
+	num_entries = 0;
+	account(-static_cast<std::ptrdiff_t>(bytes));
+}
+
+void remember_table::account(std::ptrdiff_t delta)
+{
+	bytes += delta;
+	remember_cache().account(delta);
+}
+
+/** Append an entry at the end of the removal order, i.e. it is the newest
+ *  entry and the most recently used one.  For delete_lfu it goes into the
+ *  bucket matching its hit count. */
+void remember_table::insert(const remember_table_entry & e)
+{
+	bucket_list::iterator b;
+	if (remember_strategy == remember_strategies::delete_lfu) {
+		b = buckets.begin();
+		while (b != buckets.end() && b->hits < e.get_successful_hits())
+			++b;
+		if (b == buckets.end() || b->hits != e.get_successful_hits()) {
+			b = buckets.insert(b, bucket());
+			b->hits = e.get_successful_hits();
+		}
+	} else {
+		if (buckets.empty()) {
+			buckets.push_back(bucket());
+			buckets.back().hits = 0;
+		}
+		b = buckets.begin();
+	}
+	b->entries.push_back(e);
+	index.insert(std::make_pair(e.get_hashvalue(),
+	                            position(b, --b->entries.end())));
+	++num_entries;
+	account(e.memory_size());
+}
+
+/** Update the removal order after a successful lookup. */
+void remember_table::touch(index_map::iterator pos)
+{
+	bucket_list::iterator b = pos->second.first;
+	entry_list::iterator e = pos->second.second;
+	switch (remember_strategy) {
+	case remember_strategies::delete_lru:
+		// most recently used entries go to the end
+		b->entries.splice(b->entries.end(), b->entries, e);
+		break;
+	case remember_strategies::delete_lfu: {
+		// move to the bucket with one more hit, creating it if needed
+		bucket_list::iterator next = b;
+		++next;
+		if (next == buckets.end() || next->hits != e->get_successful_hits()) {
+			next = buckets.insert(next, bucket());
+			next->hits = e->get_successful_hits();
+		}
+		next->entries.splice(next->entries.end(), b->entries, e);
+		pos->second.first = next;
+		if (b->entries.empty())
+			buckets.erase(b);
+		break;
+	}
+	default:
+		// delete_cyclic and delete_never keep the insertion order
+		break;
+	}
+}
+
+/** Remove the entry at the front of the removal order: the oldest one,
+ *  the least recently used one, or the least frequently used one.  Tables
+ *  with delete_never only lose entries when the cache_manager asks for it,
+ *  the oldest first. */
+void remember_table::remove_victim()
+{
+	GINAC_ASSERT(!buckets.empty() && !buckets.front().entries.empty());
+	bucket_list::iterator b = buckets.begin();
+	entry_list::iterator e = b->entries.begin();
+	auto range = index.equal_range(e->get_hashvalue());
+	for (auto it = range.first; it != range.second; ++it)
+		if (it->second.second == e) {
+			index.erase(it);
+			break;
+		}
+	const size_t freed = e->memory_size();
+	--num_entries;
+	b->entries.erase(e);
+	if (b->entries.empty())
+		buckets.erase(b);
+	account(-static_cast<std::ptrdiff_t>(freed));
 }
 
-void remember_table::init_table()
+void remember_table::show_statistics(std::ostream & os, unsigned level) const
 {
-	reserve(table_size);
-	for (unsigned i=0; i<table_size; ++i)
-		push_back(remember_table_list(max_assoc_size,remember_strategy));
+	os << std::string(level, ' ') << "remember table";
+	if (!name.empty())
+		os << " of " << name;
+	os << ": " << num_entries << " entries";
+	if (max_entries != 0)
+		os << " (max " << max_entries << ")";
+	os << ", " << bytes << " bytes, " << lookups << " lookups, "
+	   << hits << " hits";
+	if (lookups != 0)
+		os << " (" << (100.0 * hits) / lookups << "%)";
+	os << std::endl;
 }
 
-std::vector<remember_table> & remember_table::remember_tables()
+/** The remember tables of all functions, indexed by serial.  A deque, so
+ *  that tables are never copied or moved when new ones are added while
+ *  the cache_manager may be walking them. */
+std::deque<remember_table> & remember_table::remember_tables()
 {
-	static auto  rt = new std::vector<remember_table>;
+	static auto  rt = new std::deque<remember_table>;
 	return *rt;
 }
 
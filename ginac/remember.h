@@ -24,9 +24,13 @@
 #ifndef __GINAC_REMEMBER_H__
 #define __GINAC_REMEMBER_H__
 
+#include <cstddef>
 #include <iosfwd>
 #include <vector>
+#include <deque>
 #include <list>
+#include <string>
+#include <unordered_map>
 
 namespace GiNaC {
 
@@ -42,8 +46,10 @@ public:
 	remember_table_entry(function const & f, ex  r);
 	bool is_equal(function const & f) const;
 	ex get_result() const { return result; }
+	long get_hashvalue() const { return hashvalue; }
 	unsigned long get_last_access() const { return last_access; }
 	unsigned long get_successful_hits() const { return successful_hits; };
+	size_t memory_size() const;
 
 protected:
 	long hashvalue;
@@ -54,46 +60,61 @@ protected:
 	static unsigned long access_counter;
 };    
 
-/** A list of entries in the remember table having some least
- *  significant bits of the hashvalue in common. */
-class remember_table_list : public std::list<remember_table_entry> {
-public:
-	remember_table_list(unsigned as, unsigned strat);
-	void add_entry(function const & f, ex const & result);
-	bool lookup_entry(function const & f, ex & result) const;
-protected:
-	unsigned max_assoc_size;
-	unsigned remember_strategy;
-};
-
-/** The remember table is organized like an n-fold associative cache
- *  in a microprocessor.  The table has a width of 's' (which is rounded
- *  to table_size, some power of 2 near 's', internally) and a depth of 'as'
- *  (unless you choose that entries are never discarded). The place where
- *  an entry is stored depends on the hashvalue of the parameters of the
- *  function (this corresponds to the address of byte to be cached).
- *  The 'log_2(table_size)' least significant bits of this hashvalue
- *  give the slot in which the entry will be stored or looked up.
- *  Each slot can take up to 'as' entries. If a slot is full, an older
- *  entry is removed by one of the following strategies:
- *   - oldest entry (the first one in the list)
+/** The remember table of a function.  Entries are found through a hash
+ *  index on the hashvalue of the function, so lookups take constant time.
+ *  The table holds up to 's*as' entries (with 's' rounded to a power of 2,
+ *  for compatibility with the former slot based organization), or all
+ *  entries if 'as' is zero or the strategy is delete_never.  If the table
+ *  is full, an entry is removed by one of the following strategies:
+ *   - oldest entry (the first one inserted)
  *   - least recently used (the one with the lowest 'last_access')
  *   - least frequently used (the one with the lowest 'successful_hits')
- *  or all entries are kept which means that the table grows indefinitely. */
-class remember_table : public std::vector<remember_table_list> {
+ *  The entries are kept in lists ordered by these criteria, so finding the
+ *  entry to remove takes constant time, too.  For delete_lfu the entries
+ *  are grouped into buckets of equal 'successful_hits'.
+ *
+ *  All remember tables together are one cache of the cache_manager, which
+ *  may evict entries from the largest tables to stay within its budget. */
+class remember_table {
+	friend class remember_tables_cache;
 public:
 	remember_table();
-	remember_table(unsigned s, unsigned as, unsigned strat);
-	bool lookup_entry(function const & f, ex & result) const;
+	remember_table(unsigned s, unsigned as, unsigned strat,
+	               const std::string & n = std::string());
+	remember_table(const remember_table & other);
+	remember_table & operator=(const remember_table & other);
+	~remember_table();
+	bool lookup_entry(function const & f, ex & result);
 	void add_entry(function const & f, ex const & result);
 	void clear_all_entries();
 	void show_statistics(std::ostream & os, unsigned level) const;
-	static std::vector<remember_table> & remember_tables();
+	size_t size() const { return num_entries; }
+	size_t memory_size() const { return bytes; }
+	static std::deque<remember_table> & remember_tables();
 protected:
-	void init_table();
-	unsigned table_size;
-	unsigned max_assoc_size;
+	typedef std::list<remember_table_entry> entry_list;
+	struct bucket {
+		unsigned long hits;
+		entry_list entries;
+	};
+	typedef std::list<bucket> bucket_list;
+	typedef std::pair<bucket_list::iterator, entry_list::iterator> position;
+	typedef std::unordered_multimap<long, position> index_map;
+
+	void insert(const remember_table_entry & e);
+	void account(std::ptrdiff_t delta);
+	void remove_victim();
+	void touch(index_map::iterator pos);
+
+	bucket_list buckets;        ///< entries, in order of removal
+	index_map index;            ///< hashvalue -> position in buckets
+	size_t max_entries;         ///< 0 means unlimited
 	unsigned remember_strategy;
+	size_t num_entries;
+	size_t bytes;               ///< estimated memory use of the entries
+	unsigned long lookups;
+	unsigned long hits;
+	std::string name;           ///< name of the function, for statistics
 };      
 
 } // namespace GiNaC